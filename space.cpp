@@ -1,16 +1,58 @@
-// compile with C++ 14 (for auto return type deduction) + OpenMP
+// compile with C++ 14 (for auto return type deduction) + OpenMP, C++ 20 adds coroutine orders
 // e.g. clang++ -g3 -std=c++14 -fopenmp space.cpp
+// run with "bench" as the only argument to compare the orders, with "shm" [ranks] to check the shared memory
+// decomposition against a single process
 
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <system_error>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <vector>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <initializer_list>
+#include <utility>
 
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 #include <omp.h>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
+
 namespace impl {
 template <int N, typename T> struct array_to_tuple {
 	constexpr static auto get(const T &arr) noexcept {
@@ -23,35 +65,8 @@ template <typename T> struct array_to_tuple<1, T> {
 };
 }
 
-template <int DIM, typename spaceT> struct iteration {
-	static constexpr int dim = DIM;
-
-	std::array<int, DIM> index;
-	std::function<void(decltype(index) &, spaceT)> order;
-
-	spaceT _space;
-
-	iteration<DIM, spaceT>() = delete;
-
-	iteration<DIM, spaceT>(const iteration<DIM, spaceT> &) = default;
-	iteration<DIM, spaceT>(spaceT &&s) : index(s.start), _space(std::forward<spaceT>(s)) {}
-
-	iteration<DIM, spaceT>(const spaceT &s) : index(s.start), _space(s) {}
-
-	bool operator!=(const iteration<DIM, spaceT> &rhs) const noexcept {
-		return rhs.index != index || rhs._space != _space;
-	}
-
-	void operator++() noexcept {
-		assert(order);
-		order(index, _space);
-	}
-
-	auto operator*() const noexcept { return impl::array_to_tuple<DIM, decltype(index)>::get(index); }
-};
-
-// prevent anyone from using a space with 0 dimension
-template <typename spaceT> struct iteration<0, spaceT>;
+// points of a box, column-major (first index fastest) or row-major (last index fastest)
+template <int DIM, bool COLUMN_MAJOR> struct iteration;
 
 namespace impl {
 // dense_space<1> * dense_space<1> = dense_space<2>?
@@ -60,37 +75,85 @@ template <int DIM> struct dense_space {
 
 	std::array<int, DIM> start, limit;
 
+	// empty
+	constexpr dense_space() : start(), limit() {}
 	dense_space(const dense_space<DIM> &s) = default;
 	dense_space(dense_space<DIM> &&s) = default;
+	dense_space<DIM> &operator=(const dense_space<DIM> &s) = default;
+	dense_space<DIM> &operator=(dense_space<DIM> &&s) = default;
 
 	// first parameter const int to make sure it is not used as a copy constructor
-	template <typename... argsT> dense_space(const int i, argsT &&... args) {
+	template <typename... argsT> constexpr dense_space(const int i, argsT &&... args) : start(), limit() {
 		static_assert(sizeof...(args) + 1 == DIM * 2, "Missing constructor parameters for dense_space.");
 		init<DIM>(i, std::forward<argsT>(args)...);
 	}
 
+	constexpr dense_space(const std::array<int, DIM> &s, const std::array<int, DIM> &l) : start(s), limit(l) {}
+
 	bool operator!=(const dense_space<DIM> &rhs) const noexcept { return rhs.start != start || rhs.limit != limit; }
 
-	auto begin() const noexcept {
-		auto temp = iteration<DIM, dense_space<DIM>>(*this);
-		temp.index = start;
-		return temp;
+	constexpr std::ptrdiff_t size() const noexcept {
+		std::ptrdiff_t s = 1;
+		for (int d = 0; d < DIM; ++d) s *= std::max(0, limit[d] - start[d]);
+		return s;
 	}
-	auto end() const noexcept {
-		auto temp = iteration<DIM, dense_space<DIM>>(*this);
-		temp.index = limit;
-		return temp;
+
+	constexpr bool empty() const noexcept { return size() == 0; }
+
+	constexpr bool contains(const std::array<int, DIM> &idx) const noexcept {
+		for (int d = 0; d < DIM; ++d)
+			if (idx[d] < start[d] || idx[d] >= limit[d]) return false;
+		return true;
+	}
+
+	// row-major position of idx in the space, in [0, size()) for the points it contains
+	constexpr std::ptrdiff_t linear_offset(const std::array<int, DIM> &idx) const noexcept {
+		std::ptrdiff_t o = 0;
+		for (int d = 0; d < DIM; ++d) o = o * (limit[d] - start[d]) + (idx[d] - start[d]);
+		return o;
+	}
+
+	// the points at least width[d] away from the lower and upper boundary of every dimension d
+	dense_space<DIM> interior(const std::array<int, DIM> &width) const noexcept {
+		dense_space<DIM> r(*this);
+		for (int d = 0; d < DIM; ++d) {
+			r.start[d] = std::min(start[d] + width[d], limit[d]);
+			r.limit[d] = std::max(r.start[d], limit[d] - width[d]);
+		}
+		return r;
+	}
+
+	// disjoint strips covering everything but interior(width), empty strips are left out
+	std::vector<dense_space<DIM>> boundary(const std::array<int, DIM> &width) const {
+		const dense_space<DIM> inner = interior(width);
+		std::vector<dense_space<DIM>> strips;
+		dense_space<DIM> rest(*this); // dimensions before d are already cut down to the interior
+		for (int d = 0; d < DIM; ++d) {
+			dense_space<DIM> lower(rest), upper(rest);
+			lower.limit[d] = inner.start[d];
+			upper.start[d] = inner.limit[d];
+			if (!lower.empty()) strips.push_back(lower);
+			if (!upper.empty()) strips.push_back(upper);
+			rest.start[d] = inner.start[d];
+			rest.limit[d] = inner.limit[d];
+		}
+		return strips;
 	}
 
+	// spaces are traversed row-major by default, like C arrays are laid out
+	auto begin() const noexcept { return iteration<DIM, false>(*this, false); }
+	auto end() const noexcept { return iteration<DIM, false>(*this, true); }
+
   private:
-	template <int N, typename... argsT> void init(const int _start, const int _end, argsT &&... args) noexcept {
+	template <int N, typename... argsT>
+	constexpr void init(const int _start, const int _end, argsT &&... args) noexcept {
 		static_assert(sizeof...(args) == (N - 1) * 2, "Internal error. Something is broken with our constructor.");
 		start[DIM - N] = _start;
 		limit[DIM - N] = _end;
 		init<N - 1>(std::forward<argsT>(args)...);
 	}
 
-	template <int N> void init(const int _start, const int _end) {
+	template <int N> constexpr void init(const int _start, const int _end) noexcept {
 		start[DIM - N] = _start;
 		limit[DIM - N] = _end;
 	}
@@ -98,7 +161,7 @@ template <int DIM> struct dense_space {
 }
 
 // just a little helper
-template <typename... argsT> auto dense_space(argsT &&... args) {
+template <typename... argsT> constexpr auto dense_space(argsT &&... args) {
 	static_assert(sizeof...(args) % 2 == 0, "Wrong number of parameters for dense_space");
 	return impl::dense_space<sizeof...(argsT) / 2>(std::forward<argsT>(args)...);
 }
@@ -135,25 +198,18 @@ template <typename spaceT> struct cm_order {
 	cm_order(const spaceT &s) : _space(s) {}
 	cm_order(spaceT &&s) : _space(std::forward<spaceT>(s)) {}
 
-	auto begin() const noexcept {
-		iteration<spaceT::dim, spaceT> temp(_space);
-		temp.order = impl::cm_next<spaceT::dim, decltype(_space.start), spaceT>::get;
-
-		return temp;
-	}
+	cm_order<spaceT> &operator=(const cm_order<spaceT> &) = default;
+	cm_order<spaceT> &operator=(cm_order<spaceT> &&) = default;
 
-	auto end() const noexcept {
-		iteration<spaceT::dim, spaceT> temp(_space);
-		temp.index = _space.limit;
-		temp.order = impl::cm_next<spaceT::dim, decltype(_space.start), spaceT>::get;
+	std::ptrdiff_t size() const noexcept { return end() - begin(); }
 
-		return temp;
-	}
+	auto begin() const noexcept { return iteration<spaceT::dim, true>(_space, false); }
+	auto end() const noexcept { return iteration<spaceT::dim, true>(_space, true); }
 };
 }
 
 // just a little helper
-template <typename T> auto cm_order(T &&instance) { return impl::cm_order<T>(std::forward<T>(instance)); }
+template <typename T> auto cm_order(T &&instance) { return impl::cm_order<std::decay_t<T>>(std::forward<T>(instance)); }
 
 namespace impl {
 template <int N, typename T, typename spaceT> struct rm_next {
@@ -187,52 +243,2909 @@ template <typename spaceT> struct rm_order {
 	rm_order(const spaceT &s) : _space(s) {}
 	rm_order(spaceT &&s) : _space(std::forward<spaceT>(s)) {}
 
-	auto begin() const noexcept {
-		iteration<spaceT::dim, spaceT> temp(_space);
-		temp.order = impl::rm_next<spaceT::dim, decltype(_space.start), spaceT>::get;
+	rm_order<spaceT> &operator=(const rm_order<spaceT> &) = default;
+	rm_order<spaceT> &operator=(rm_order<spaceT> &&) = default;
 
-		return temp;
+	std::ptrdiff_t size() const noexcept { return end() - begin(); }
+
+	auto begin() const noexcept { return iteration<spaceT::dim, false>(_space, false); }
+	auto end() const noexcept { return iteration<spaceT::dim, false>(_space, true); }
+};
+}
+
+// just a little helper
+template <typename T> auto rm_order(T &&instance) { return impl::rm_order<std::decay_t<T>>(std::forward<T>(instance)); }
+
+// Random access for C++20 ranges. Dereferencing yields the tuple by value, so like the iterator of iota_view it
+// only claims to be an input iterator to C++17 algorithms. Stepping uses cm_next/rm_next, jumps recompute the
+// index from the position.
+template <int DIM, bool COLUMN_MAJOR> struct iteration {
+	static_assert(DIM > 0, "Spaces need at least one dimension.");
+	static constexpr int dim = DIM;
+
+	using value_type = decltype(impl::array_to_tuple<DIM, std::array<int, DIM>>::get(std::array<int, DIM>()));
+	using reference = value_type;
+	using pointer = void;
+	using difference_type = std::ptrdiff_t;
+	using iterator_category = std::input_iterator_tag;
+	using iterator_concept = std::random_access_iterator_tag;
+
+	std::array<int, DIM> index; // limit once past the end
+	difference_type pos;		// number of points before index
+	impl::dense_space<DIM> _space;
+
+	iteration() : index(), pos(0) {}
+	iteration(const iteration<DIM, COLUMN_MAJOR> &) = default;
+	iteration<DIM, COLUMN_MAJOR> &operator=(const iteration<DIM, COLUMN_MAJOR> &) = default;
+
+	// only start and limit of the (maybe partitioned) space are kept, that keeps iterations cheap to copy
+	template <typename spaceT>
+	iteration(const spaceT &s, const bool at_end) : _space(s.start, s.limit) {
+		pos = at_end ? _space.size() : 0;
+		seek();
 	}
 
-	auto end() const noexcept {
-		iteration<spaceT::dim, spaceT> temp(_space);
-		temp.index = _space.limit;
-		temp.order = impl::rm_next<spaceT::dim, decltype(_space.start), spaceT>::get;
+	value_type operator*() const noexcept { return impl::array_to_tuple<DIM, decltype(index)>::get(index); }
+	value_type operator[](const difference_type n) const noexcept { return *(*this + n); }
 
+	iteration<DIM, COLUMN_MAJOR> &operator++() noexcept {
+		next_type::get(index, _space);
+		++pos;
+		return *this;
+	}
+	iteration<DIM, COLUMN_MAJOR> operator++(int) noexcept {
+		auto temp = *this;
+		++*this;
+		return temp;
+	}
+	iteration<DIM, COLUMN_MAJOR> &operator--() noexcept { return *this -= 1; }
+	iteration<DIM, COLUMN_MAJOR> operator--(int) noexcept {
+		auto temp = *this;
+		--*this;
 		return temp;
 	}
-};
-}
 
-// just a little helper
-template <typename T> auto rm_order(T &&instance) { return impl::rm_order<T>(std::forward<T>(instance)); }
+	iteration<DIM, COLUMN_MAJOR> &operator+=(const difference_type n) noexcept {
+		pos += n;
+		seek();
+		return *this;
+	}
+	iteration<DIM, COLUMN_MAJOR> &operator-=(const difference_type n) noexcept { return *this += -n; }
+	iteration<DIM, COLUMN_MAJOR> operator+(const difference_type n) const noexcept {
+		auto temp = *this;
+		return temp += n;
+	}
+	iteration<DIM, COLUMN_MAJOR> operator-(const difference_type n) const noexcept {
+		auto temp = *this;
+		return temp -= n;
+	}
+	friend iteration<DIM, COLUMN_MAJOR> operator+(const difference_type n, const iteration<DIM, COLUMN_MAJOR> &i) {
+		return i + n;
+	}
+	difference_type operator-(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos - rhs.pos; }
+
+	bool operator==(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos == rhs.pos; }
+	bool operator!=(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos != rhs.pos; }
+	bool operator<(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos < rhs.pos; }
+	bool operator>(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos > rhs.pos; }
+	bool operator<=(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos <= rhs.pos; }
+	bool operator>=(const iteration<DIM, COLUMN_MAJOR> &rhs) const noexcept { return pos >= rhs.pos; }
+
+  private:
+	using next_type = std::conditional_t<COLUMN_MAJOR, impl::cm_next<DIM, decltype(index), impl::dense_space<DIM>>,
+										 impl::rm_next<DIM, decltype(index), impl::dense_space<DIM>>>;
+
+	void seek() noexcept {
+		if (pos < 0 || pos >= _space.size()) {
+			index = _space.limit;
+			return;
+		}
+		difference_type rest = pos;
+		for (int k = 0; k < DIM; ++k) {
+			const int d = COLUMN_MAJOR ? k : DIM - 1 - k; // fastest dimension first
+			const int extent = _space.limit[d] - _space.start[d];
+			index[d] = _space.start[d] + int(rest % extent);
+			rest /= extent;
+		}
+	}
+};
 
 namespace impl {
+// the id-th of parts nearly equal pieces of [begin, end)
+constexpr std::pair<int, int> split(const int begin, const int end, const int parts, const int id) noexcept {
+	const int size = end - begin, base = size / parts, rest = size % parts;
+	const int b = begin + base * id + std::min(id, rest);
+	return {b, b + base + (id < rest ? 1 : 0)};
+}
+
+// the calling thread's slab of the space, size(), contains() etc. describe the slab
 template <typename spaceT> struct static_partition : public spaceT {
 	static_partition() = delete;
 	static_partition(const static_partition<spaceT> &) = default;
 	static_partition(static_partition<spaceT> &&) = default;
+	static_partition<spaceT> &operator=(const static_partition<spaceT> &) = default;
+	static_partition<spaceT> &operator=(static_partition<spaceT> &&) = default;
 
-	static_partition(const int dim, const spaceT &o) : spaceT(o) { partition(dim); }
-	static_partition(const int dim, spaceT &&o) : spaceT(std::forward<spaceT>(o)) { partition(dim); }
+	static_partition(const int dim, const spaceT &o) : spaceT(o) {
+		partition(dim, omp_get_num_threads(), omp_get_thread_num());
+	}
+	static_partition(const int dim, spaceT &&o) : spaceT(std::forward<spaceT>(o)) {
+		partition(dim, omp_get_num_threads(), omp_get_thread_num());
+	}
+	// slab of slabs instead of the one of the calling thread
+	static_partition(const int dim, const spaceT &o, const int slabs, const int slab) : spaceT(o) {
+		partition(dim, slabs, slab);
+	}
 
   private:
-	void partition(const int dim) noexcept {
-		int id = omp_get_thread_num();
-		int threads = omp_get_num_threads();
-		int size = spaceT::limit[dim] - spaceT::start[dim];
-		spaceT::start[dim] = (size / threads) * id;
-		if (id != threads - 1) spaceT::limit[dim] = size / threads * (id + 1);
+	// the remainder goes to the first slabs, one row each
+	void partition(const int dim, const int slabs, const int slab) noexcept {
+		std::tie(spaceT::start[dim], spaceT::limit[dim]) = split(spaceT::start[dim], spaceT::limit[dim], slabs, slab);
 	}
 };
 }
 
 // just a little helper
 template <typename T> auto static_partition(const int dim, T &&instance) {
-	return impl::static_partition<T>(dim, std::forward<T>(instance));
+	return impl::static_partition<std::decay_t<T>>(dim, std::forward<T>(instance));
 }
 
-int main(int argc, char const *argv[]) {
+// bfloat16: the upper half of an IEEE single, rounded to nearest even on conversion
+struct bfloat16 {
+	std::uint16_t bits;
+
+	bfloat16() = default;
+	bfloat16(const float f) noexcept : bits(from_float(f)) {}
+
+	operator float() const noexcept { return to_float(bits); }
+
+	static float to_float(const std::uint16_t b) noexcept {
+		const std::uint32_t u = std::uint32_t(b) << 16;
+		float f;
+		std::memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	static std::uint16_t from_float(const float f) noexcept {
+		std::uint32_t u;
+		std::memcpy(&u, &f, sizeof(u));
+		// keep NaNs NaN, rounding could turn them into infinity
+		if ((u & 0x7fffffffu) > 0x7f800000u) return std::uint16_t((u >> 16) | 0x40u);
+		u += 0x7fffu + ((u >> 16) & 1u);
+		return std::uint16_t(u >> 16);
+	}
+};
+
+namespace impl {
+// element policy of a grid: values are kept as storageT in memory, but kernels compute with computeT
+template <typename storageT, typename computeT> struct precision {
+	using storage_type = storageT;
+	using compute_type = computeT;
+
+	static compute_type load(const storage_type v) noexcept { return compute_type(v); }
+	static storage_type store(const compute_type v) noexcept { return storage_type(v); }
+
+	// converting whole runs lets the compiler vectorize the conversion
+	static void load(const storage_type *src, compute_type *dst, const int n) noexcept {
+#pragma omp simd
+		for (int k = 0; k < n; ++k) dst[k] = load(src[k]);
+	}
+
+	static void store(const compute_type *src, storage_type *dst, const int n) noexcept {
+#pragma omp simd
+		for (int k = 0; k < n; ++k) dst[k] = store(src[k]);
+	}
+};
+
+// non-owning view of a row-major (C array layout) grid
+template <int DIM, typename policyT> struct grid {
+	static constexpr int dim = DIM;
+	using storage_type = typename policyT::storage_type;
+	using value_type = typename policyT::compute_type;
+
+	storage_type *_data;
+	std::array<int, DIM> extent;
+
+	grid() = delete;
+	grid(const grid<DIM, policyT> &) = default;
+	grid(grid<DIM, policyT> &&) = default;
+
+	grid(storage_type *data, const std::array<int, DIM> &e) : _data(data), extent(e) {}
+
+	std::ptrdiff_t offset(const std::array<int, DIM> &idx) const noexcept {
+		std::ptrdiff_t o = idx[0];
+		for (int d = 1; d < DIM; ++d) o = o * extent[d] + idx[d];
+		return o;
+	}
+
+	storage_type *data(const std::array<int, DIM> &idx) const noexcept { return _data + offset(idx); }
+
+	template <typename... idxT> value_type load(const idxT... idx) const noexcept {
+		static_assert(sizeof...(idx) == DIM, "Wrong number of indices for grid.");
+		return policyT::load(_data[offset({{idx...}})]);
+	}
+
+	template <typename... idxT> void store(const value_type v, const idxT... idx) noexcept {
+		static_assert(sizeof...(idx) == DIM, "Wrong number of indices for grid.");
+		_data[offset({{idx...}})] = policyT::store(v);
+	}
+
+	// n consecutive elements of the innermost dimension, starting at idx
+	void load(const std::array<int, DIM> &idx, value_type *dst, const int n) const noexcept {
+		policyT::load(data(idx), dst, n);
+	}
+	void store(const value_type *src, const std::array<int, DIM> &idx, const int n) noexcept {
+		policyT::store(src, data(idx), n);
+	}
+};
+}
+
+// just a little helper
+template <typename T, typename... argsT> auto grid(T *data, argsT... extents) {
+	return impl::grid<sizeof...(argsT), impl::precision<T, T>>(data, {{extents...}});
+}
+
+// same as grid, but kernels load and store computeT, e.g. mixed_grid<double>(float_ptr, 100, 100)
+template <typename computeT, typename T, typename... argsT> auto mixed_grid(T *data, argsT... extents) {
+	return impl::grid<sizeof...(argsT), impl::precision<T, computeT>>(data, {{extents...}});
+}
+
+// iterative refinement: recovers full accuracy for solvers running on low-precision grids.
+// residual() computes r = b - Ax in high precision and returns its norm, correct() approximately
+// solves Ae = r (e.g. a few Jacobi or CG sweeps on mixed_grids) and adds e to x.
+template <typename residualT, typename correctT>
+int refine(residualT &&residual, correctT &&correct, const double tolerance, const int max_steps) {
+	int step = 0;
+	for (; step < max_steps; ++step) {
+		if (residual() <= tolerance) break;
+		correct();
+	}
+	return step;
+}
+
+namespace impl {
+template <typename iterationT, typename... gridsT> struct prefetch_iteration {
+	iterationT current, ahead, last;
+	std::tuple<gridsT...> grids; // grids are cheap views, copies keep iterations valid without the order
+
+	bool operator!=(const prefetch_iteration &rhs) const noexcept { return current != rhs.current; }
+
+	void operator++() noexcept {
+		++current;
+		advance();
+	}
+
+	auto operator*() const noexcept { return *current; }
+
+	// moves the lookahead iteration one point further and prefetches what it will touch
+	void advance() noexcept {
+		if (!(ahead != last)) return;
+		++ahead;
+		if (ahead != last) prefetch(std::index_sequence_for<gridsT...>());
+	}
+
+  private:
+	template <std::size_t... I> void prefetch(std::index_sequence<I...>) const noexcept {
+		int dummy[] = {0, (__builtin_prefetch(std::get<I>(grids).data(ahead.index)), 0)...};
+		(void)dummy;
+	}
+};
+
+template <typename orderT, typename... gridsT> struct prefetch_order {
+	using iteration_type = decltype(std::declval<const orderT &>().begin());
+
+	orderT _order; // any order, the jumps of the wrapped one are what we hide
+	int _distance;
+	std::tuple<gridsT...> _grids;
+
+	prefetch_order() = delete;
+	prefetch_order(const prefetch_order<orderT, gridsT...> &) = default;
+	prefetch_order(prefetch_order<orderT, gridsT...> &&) = default;
+
+	prefetch_order(const orderT &o, const int distance, const gridsT &... grids)
+		: _order(o), _distance(distance), _grids(grids...) {}
+	prefetch_order(orderT &&o, const int distance, const gridsT &... grids)
+		: _order(std::forward<orderT>(o)), _distance(distance), _grids(grids...) {}
+
+	auto begin() const noexcept {
+		prefetch_iteration<iteration_type, gridsT...> temp{_order.begin(), _order.begin(), _order.end(), _grids};
+		for (int i = 0; i < _distance; ++i) temp.advance();
+		return temp;
+	}
+
+	auto end() const noexcept {
+		return prefetch_iteration<iteration_type, gridsT...>{_order.end(), _order.end(), _order.end(), _grids};
+	}
+};
+}
+
+// just a little helper
+// prefetches the elements of grids the wrapped order visits distance points ahead
+template <typename T, typename... gridsT> auto prefetch_order(T &&order, const int distance, const gridsT &... grids) {
+	return impl::prefetch_order<std::decay_t<T>, gridsT...>(std::forward<T>(order), distance, grids...);
+}
+
+// fastest of a few runs of f in seconds
+template <typename F> double best_time(F &&f, const int repetitions = 3) {
+	double time = -1;
+	for (int r = 0; r < repetitions; ++r) {
+		const double t = omp_get_wtime();
+		f();
+		const double elapsed = omp_get_wtime() - t;
+		if (time < 0 || elapsed < time) time = elapsed;
+	}
+	return time;
+}
+
+// runs f(candidate) a few times per candidate and returns the fastest candidate,
+// e.g. tune({0, 4, 8, 16, 32}, [&](int d) { sweep with prefetch_order(..., d, ...); })
+template <typename T, typename F> T tune(const std::initializer_list<T> candidates, F &&f, const int repetitions = 3) {
+	assert(candidates.size() > 0);
+	T best = *candidates.begin();
+	double best_elapsed = -1;
+	for (const auto &c : candidates) {
+		const double elapsed = best_time([&] { f(c); }, repetitions);
+		if (best_elapsed < 0 || elapsed < best_elapsed) {
+			best = c;
+			best_elapsed = elapsed;
+		}
+	}
+	return best;
+}
+
+// size of the last level cache in bytes as reported by sysfs, 0 if unknown
+inline std::size_t llc_size() {
+	static const std::size_t size = [] {
+		std::size_t result = 0;
+		int result_level = 0;
+		for (int i = 0;; ++i) {
+			const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i);
+			std::ifstream level_file(dir + "/level"), size_file(dir + "/size");
+			if (!level_file || !size_file) break;
+			int level = 0;
+			std::size_t bytes = 0;
+			char unit = 0;
+			level_file >> level;
+			size_file >> bytes >> unit;
+			if (unit == 'K') bytes <<= 10;
+			if (unit == 'M') bytes <<= 20;
+			if (level >= result_level) {
+				result = bytes;
+				result_level = level;
+			}
+		}
+		return result;
+	}();
+	return size;
+}
+
+namespace impl {
+// width of the vector registers we generate code for, also the alignment vector bodies start at
+#if defined(__AVX__)
+constexpr std::size_t vector_bytes = 32;
+#else
+constexpr std::size_t vector_bytes = 16;
+#endif
+
+// output accessor for write-only grids. With streaming enabled, inner runs are written with non-temporal
+// stores, which skip the read-for-ownership of the target cache lines.
+template <int DIM, typename policyT> struct streaming_output {
+	using storage_type = typename policyT::storage_type;
+	using value_type = typename policyT::compute_type;
+
+	static_assert(vector_bytes % sizeof(storage_type) == 0, "Grid element does not fit into a vector register.");
+	static constexpr int vector_length = vector_bytes / sizeof(storage_type);
+
+	grid<DIM, policyT> _grid;
+	bool streaming;
+
+	streaming_output() = delete;
+	streaming_output(const streaming_output<DIM, policyT> &) = delete;
+	streaming_output(streaming_output<DIM, policyT> &&) = default;
+
+	streaming_output(const grid<DIM, policyT> &g, const bool s) : _grid(g), streaming(s) {}
+
+	// the partition ends with its accessor, streamed stores must be visible before anyone reads them
+	~streaming_output() { fence(); }
+
+	// stores f(j) for the n points of the inner run starting at idx, where j is the inner index
+	template <typename F> void store_run(std::array<int, DIM> idx, const int n, F &&f) noexcept {
+		const int first = idx[DIM - 1];
+		storage_type *dst = _grid.data(idx);
+		int j = 0;
+#if defined(__SSE2__)
+		if (streaming && reinterpret_cast<std::uintptr_t>(dst) % sizeof(storage_type) == 0) {
+			// scalar stores up to the first aligned element
+			for (; j < n && reinterpret_cast<std::uintptr_t>(dst + j) % vector_bytes != 0; ++j)
+				dst[j] = policyT::store(f(first + j));
+			for (; j + vector_length <= n; j += vector_length) {
+				alignas(vector_bytes) storage_type chunk[vector_length];
+				for (int k = 0; k < vector_length; ++k) chunk[k] = policyT::store(f(first + j + k));
+#if defined(__AVX__)
+				_mm256_stream_si256(reinterpret_cast<__m256i *>(dst + j),
+									_mm256_load_si256(reinterpret_cast<const __m256i *>(chunk)));
+#else
+				_mm_stream_si128(reinterpret_cast<__m128i *>(dst + j),
+								 _mm_load_si128(reinterpret_cast<const __m128i *>(chunk)));
+#endif
+			}
+		}
+#endif
+		for (; j < n; ++j) dst[j] = policyT::store(f(first + j));
+	}
+
+	void fence() const noexcept {
+#if defined(__SSE2__)
+		if (streaming) _mm_sfence();
+#endif
+	}
+};
+}
+
+// just a little helper
+// streams only if the grid does not fit into the last level cache anyway
+template <int DIM, typename policyT> auto streaming_output(const impl::grid<DIM, policyT> &g) {
+	std::size_t bytes = sizeof(typename policyT::storage_type);
+	for (const int e : g.extent) bytes *= e;
+	const std::size_t llc = llc_size();
+	return impl::streaming_output<DIM, policyT>(g, llc != 0 && bytes > llc);
+}
+
+template <int DIM, typename policyT> auto streaming_output(const impl::grid<DIM, policyT> &g, const bool streaming) {
+	return impl::streaming_output<DIM, policyT>(g, streaming);
+}
+
+// row-major traversal of space by innermost rows. Each row is split at the elements of g that are aligned to
+// the vector width: prologue(idx, n) gets the unaligned head, body(idx, n) the aligned middle whose length n is
+// a multiple of the vector length, and epilogue(idx, n) the rest. idx is the first index of each part.
+template <typename spaceT, int DIM, typename policyT, typename prologueT, typename bodyT, typename epilogueT>
+void peeled_rows(const spaceT &space, const impl::grid<DIM, policyT> &g, prologueT &&prologue, bodyT &&body,
+				 epilogueT &&epilogue) {
+	static_assert(spaceT::dim == DIM, "Space and grid dimensions differ.");
+	using storage_type = typename policyT::storage_type;
+	constexpr int vector_length = impl::vector_bytes / sizeof(storage_type);
+
+	for (int d = 0; d < DIM; ++d)
+		if (space.start[d] >= space.limit[d]) return;
+
+	std::array<int, DIM> idx = space.start;
+	const int first = space.start[DIM - 1], length = space.limit[DIM - 1] - first;
+	for (;;) {
+		idx[DIM - 1] = first;
+		const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(g.data(idx));
+		int head = length;
+		if (address % sizeof(storage_type) == 0) {
+			const int misaligned = int(address % impl::vector_bytes / sizeof(storage_type));
+			head = std::min(length, misaligned == 0 ? 0 : vector_length - misaligned);
+		}
+		const int middle = (length - head) / vector_length * vector_length;
+
+		if (head > 0) prologue(idx, head);
+		idx[DIM - 1] = first + head;
+		if (middle > 0) body(idx, middle);
+		idx[DIM - 1] = first + head + middle;
+		if (length - head - middle > 0) epilogue(idx, length - head - middle);
+
+		// next row
+		int d = DIM - 2;
+		for (; d >= 0; --d) {
+			if (++idx[d] < space.limit[d]) break;
+			idx[d] = space.start[d];
+		}
+		if (d < 0) break;
+	}
+}
+
+namespace impl {
+template <int D, int DIM> struct rm_loop {
+	template <typename F>
+	static void run(const std::array<int, DIM> &start, const std::array<int, DIM> &limit, std::array<int, DIM> &idx,
+					F &&f) {
+		for (idx[D] = start[D]; idx[D] < limit[D]; ++idx[D]) rm_loop<D + 1, DIM>::run(start, limit, idx, f);
+	}
+};
+
+template <int DIM> struct rm_loop<DIM, DIM> {
+	template <typename F>
+	static void run(const std::array<int, DIM> &, const std::array<int, DIM> &, std::array<int, DIM> &idx, F &&f) {
+		f(const_cast<const std::array<int, DIM> &>(idx));
+	}
+};
+
+// row-major traversal as plain nested loops, f gets the index array
+template <typename spaceT, typename F> void rm_for_each(const spaceT &space, F &&f) {
+	std::array<int, spaceT::dim> idx;
+	rm_loop<0, spaceT::dim>::run(space.start, space.limit, idx, f);
+}
+
+// f(args..., idx[0], idx[1], ...)
+template <typename F, std::size_t N, std::size_t... I, typename... argsT>
+decltype(auto) apply_index(F &&f, const std::array<int, N> &idx, std::index_sequence<I...>, argsT &&... args) {
+	return f(std::forward<argsT>(args)..., idx[I]...);
+}
+
+// many small independent spaces, each with its grid bindings, run in a single parallel region
+template <typename spaceT, typename bindingT> struct batch {
+	struct work {
+		int item;
+		spaceT space; // the whole item or a slab of it
+	};
+
+	std::vector<spaceT> spaces;
+	std::vector<bindingT> bindings;
+
+	void add(const spaceT &s, const bindingT &b) {
+		spaces.push_back(s);
+		bindings.push_back(b);
+		_plan.clear();
+	}
+
+	// kernel(binding, i, j, ...) for every point of every space. Outside of a parallel region it opens one, inside
+	// call it by all threads of the region.
+	template <typename kernelT> void run(kernelT &&kernel) {
+		if (omp_in_parallel()) {
+			run_team(kernel);
+			return;
+		}
+#pragma omp parallel
+		run_team(kernel);
+	}
+
+	// Spaces larger than a thread's share are split into slabs along dimension 0, everything else runs whole.
+	// The pieces are then handed out largest first to the least loaded thread.
+	void partition(const int threads) {
+		long total = 0;
+		for (const auto &s : spaces) total += s.size();
+		const long share = std::max(1L, (total + threads - 1) / threads);
+
+		std::vector<work> pieces;
+		for (int i = 0; i < int(spaces.size()); ++i) {
+			const spaceT &s = spaces[i];
+			const long v = s.size();
+			if (v == 0) continue;
+			const int rows = s.limit[0] - s.start[0];
+			const int slabs = int(std::min<long>(rows, (v + share - 1) / share));
+			for (int k = 0; k < slabs; ++k) {
+				work w{i, s};
+				std::tie(w.space.start[0], w.space.limit[0]) = split(s.start[0], s.limit[0], slabs, k);
+				pieces.push_back(w);
+			}
+		}
+		std::stable_sort(pieces.begin(), pieces.end(),
+						 [](const work &a, const work &b) { return a.space.size() > b.space.size(); });
+
+		_plan.assign(threads, {});
+		std::vector<long> load(threads, 0);
+		for (const auto &w : pieces) {
+			const int t = int(std::min_element(load.begin(), load.end()) - load.begin());
+			load[t] += w.space.size();
+			_plan[t].push_back(w);
+		}
+		// keep every thread's items in insertion order
+		for (auto &p : _plan)
+			std::stable_sort(p.begin(), p.end(), [](const work &a, const work &b) { return a.item < b.item; });
+	}
+
+  private:
+	std::vector<std::vector<work>> _plan;
+
+	// the plan is made for the team that actually runs, which may be smaller than omp_get_max_threads()
+	template <typename kernelT> void run_team(kernelT &kernel) {
+#pragma omp single
+		if (int(_plan.size()) != omp_get_num_threads()) partition(omp_get_num_threads());
+
+		for (const auto &w : _plan[omp_get_thread_num()]) {
+			bindingT &b = bindings[w.item];
+			rm_for_each(w.space, [&](const std::array<int, spaceT::dim> &idx) {
+				apply_index(kernel, idx, std::make_index_sequence<spaceT::dim>(), b);
+			});
+		}
+#pragma omp barrier
+	}
+};
+}
+
+// just a little helper
+template <int DIM, typename bindingT> using batch = impl::batch<impl::dense_space<DIM>, bindingT>;
+
+namespace impl {
+template <int DIM> dense_space<DIM> grow(const dense_space<DIM> &s, const int width) noexcept {
+	dense_space<DIM> r(s);
+	for (int d = 0; d < DIM; ++d) {
+		r.start[d] -= width;
+		r.limit[d] += width;
+	}
+	return r;
+}
+
+template <int DIM>
+dense_space<DIM> grow(const dense_space<DIM> &s, const decltype(dense_space<DIM>::start) &width) noexcept {
+	dense_space<DIM> r(s);
+	for (int d = 0; d < DIM; ++d) {
+		r.start[d] -= width[d];
+		r.limit[d] += width[d];
+	}
+	return r;
+}
+
+template <int DIM> dense_space<DIM> intersect(const dense_space<DIM> &a, const dense_space<DIM> &b) noexcept {
+	dense_space<DIM> r(a);
+	for (int d = 0; d < DIM; ++d) {
+		r.start[d] = std::max(a.start[d], b.start[d]);
+		r.limit[d] = std::max(r.start[d], std::min(a.limit[d], b.limit[d]));
+	}
+	return r;
+}
+
+inline int floor_div(const int a, const int b) noexcept { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+// one level of a block-structured AMR hierarchy: a set of disjoint dense_space patches in the index space of the
+// level, each owning its values plus a ghost layer
+template <int DIM, typename T = double> struct amr_level {
+	int ratio;	// refinement ratio to the next coarser level
+	int ghosts; // width of the ghost layer around every patch
+	std::vector<dense_space<DIM>> patches;
+
+	amr_level() = delete;
+	amr_level(const amr_level<DIM, T> &) = default;
+	amr_level(amr_level<DIM, T> &&) = default;
+
+	amr_level(const int r, const int g, std::vector<dense_space<DIM>> p) : ratio(r), ghosts(g) { reset(std::move(p)); }
+
+	// replaces the patches, all values are lost. Patches must be aligned to ratio, so every coarse point is covered
+	// by whole fine cells of a single patch.
+	void reset(std::vector<dense_space<DIM>> p) {
+		patches = std::move(p);
+		for (const auto &patch : patches)
+			for (int d = 0; d < DIM; ++d)
+				assert(floor_div(patch.start[d], ratio) * ratio == patch.start[d] &&
+					   floor_div(patch.limit[d], ratio) * ratio == patch.limit[d] && "patch not aligned to ratio");
+		_data.clear();
+		_batch = batch<dense_space<DIM>, int>();
+		_points = 0;
+		for (int i = 0; i < int(patches.size()); ++i) {
+			_points += patches[i].size();
+			_data.emplace_back(grow(patches[i], ghosts).size());
+			_batch.add(patches[i], i);
+		}
+	}
+
+	// interior points of all patches
+	std::ptrdiff_t size() const noexcept { return _points; }
+	bool empty() const noexcept { return _points == 0; }
+	bool contains(const std::array<int, DIM> &idx) const noexcept { return find(idx) >= 0; }
+
+	// idx is in level coordinates and must lie inside the patch or its ghost layer
+	T &at(const int p, const std::array<int, DIM> &idx) noexcept { return _data[p][offset(p, idx)]; }
+	const T &at(const int p, const std::array<int, DIM> &idx) const noexcept { return _data[p][offset(p, idx)]; }
+
+	// the patch whose interior contains idx, -1 if there is none
+	int find(const std::array<int, DIM> &idx) const noexcept {
+		for (int p = 0; p < int(patches.size()); ++p)
+			if (patches[p].contains(idx)) return p;
+		return -1;
+	}
+
+	// kernel(patch, i, j, ...) for all interior points of all patches, balanced over the threads by patch
+	// volume. Inside a parallel region call it by all threads of the region.
+	template <typename kernelT> void for_each(kernelT &&kernel) { _batch.run(std::forward<kernelT>(kernel)); }
+
+  private:
+	std::vector<std::vector<T>> _data;
+	batch<dense_space<DIM>, int> _batch;
+	std::ptrdiff_t _points;
+
+	std::ptrdiff_t offset(const int p, const std::array<int, DIM> &idx) const noexcept {
+		std::ptrdiff_t o = 0;
+		for (int d = 0; d < DIM; ++d)
+			o = o * (patches[p].limit[d] - patches[p].start[d] + 2 * ghosts) + idx[d] - patches[p].start[d] + ghosts;
+		return o;
+	}
+};
+
+// whether every point of the fine patches lies over a coarse patch, the coarse patches being disjoint
+template <int DIM, typename T>
+bool nested(const amr_level<DIM, T> &coarse, const int ratio, const std::vector<dense_space<DIM>> &patches) {
+	for (auto covered : patches) {
+		for (int d = 0; d < DIM; ++d) {
+			covered.start[d] = floor_div(covered.start[d], ratio);
+			covered.limit[d] = floor_div(covered.limit[d] - 1, ratio) + 1;
+		}
+		std::ptrdiff_t inside = 0;
+		for (const auto &patch : coarse.patches) inside += intersect(covered, patch).size();
+		if (inside != std::ptrdiff_t(covered.size())) return false;
+	}
+	return true;
+}
+
+// prolongation by piecewise constant injection into the points of region (fine coordinates) of fine patch p
+template <int DIM, typename T>
+void prolong(const amr_level<DIM, T> &coarse, amr_level<DIM, T> &fine, const int p, const dense_space<DIM> &region) {
+	rm_for_each(region, [&](const std::array<int, DIM> &idx) {
+		std::array<int, DIM> c;
+		for (int d = 0; d < DIM; ++d) c[d] = floor_div(idx[d], fine.ratio);
+		const int q = coarse.find(c);
+		if (q >= 0) fine.at(p, idx) = coarse.at(q, c);
+	});
+}
+
+// restriction: every coarse point covered by a fine patch becomes the mean of its ratio^DIM fine points
+template <int DIM, typename T> void restrict_average(const amr_level<DIM, T> &fine, amr_level<DIM, T> &coarse) {
+	const int r = fine.ratio;
+
+#pragma omp parallel for schedule(dynamic)
+	for (int p = 0; p < int(fine.patches.size()); ++p) {
+		dense_space<DIM> covered(fine.patches[p]);
+		for (int d = 0; d < DIM; ++d) {
+			covered.start[d] = floor_div(covered.start[d], r);
+			covered.limit[d] = floor_div(covered.limit[d] - 1, r) + 1;
+		}
+		rm_for_each(covered, [&](const std::array<int, DIM> &c) {
+			const int q = coarse.find(c);
+			if (q < 0) return;
+			dense_space<DIM> children(c, c);
+			for (int d = 0; d < DIM; ++d) {
+				children.start[d] = c[d] * r;
+				children.limit[d] = c[d] * r + r;
+			}
+			// clipped, should an unaligned patch slip through without asserts
+			children = intersect(children, fine.patches[p]);
+			T sum = T();
+			rm_for_each(children, [&](const std::array<int, DIM> &f) { sum += fine.at(p, f); });
+			coarse.at(q, c) = sum / double(children.size());
+		});
+	}
+}
+
+// fills the ghost layers of all fine patches: from a neighbouring fine patch where there is one,
+// otherwise by prolongation from the coarse level
+template <int DIM, typename T> void fill_ghosts(const amr_level<DIM, T> &coarse, amr_level<DIM, T> &fine) {
+#pragma omp parallel for schedule(dynamic)
+	for (int p = 0; p < int(fine.patches.size()); ++p) {
+		const dense_space<DIM> &patch = fine.patches[p];
+		rm_for_each(grow(patch, fine.ghosts), [&](const std::array<int, DIM> &idx) {
+			if (patch.contains(idx)) return;
+			const int q = fine.find(idx);
+			if (q >= 0) {
+				fine.at(p, idx) = fine.at(q, idx);
+				return;
+			}
+			dense_space<DIM> point(idx, idx);
+			for (int d = 0; d < DIM; ++d) ++point.limit[d];
+			prolong(coarse, fine, p, point);
+		});
+	}
+}
+
+// Berger-Rigoutsos style clustering: the bounding box of the flagged points is accepted once at least
+// efficiency of it is flagged, otherwise it is cut at a hole in the flag signature or in half along its
+// longest dimension
+template <int DIM>
+void cluster(std::vector<std::array<int, DIM>> flagged, const double efficiency,
+			 std::vector<dense_space<DIM>> &boxes) {
+	if (flagged.empty()) return;
+	dense_space<DIM> box(flagged.front(), flagged.front());
+	for (const auto &f : flagged)
+		for (int d = 0; d < DIM; ++d) {
+			box.start[d] = std::min(box.start[d], f[d]);
+			box.limit[d] = std::max(box.limit[d], f[d] + 1);
+		}
+
+	int longest = 0;
+	for (int d = 1; d < DIM; ++d)
+		if (box.limit[d] - box.start[d] > box.limit[longest] - box.start[longest]) longest = d;
+	if (double(flagged.size()) >= efficiency * box.size() || box.limit[longest] - box.start[longest] < 2) {
+		boxes.push_back(box);
+		return;
+	}
+
+	// prefer the hole closest to the middle, any dimension
+	int cut_dim = longest, cut = (box.start[longest] + box.limit[longest]) / 2, cut_distance = -1;
+	for (int d = 0; d < DIM; ++d) {
+		std::vector<int> signature(box.limit[d] - box.start[d], 0);
+		for (const auto &f : flagged) ++signature[f[d] - box.start[d]];
+		const int middle = (box.limit[d] - box.start[d]) / 2;
+		for (int k = 1; k + 1 < int(signature.size()); ++k) {
+			if (signature[k] != 0) continue;
+			const int distance = std::abs(k - middle);
+			if (cut_distance < 0 || distance < cut_distance) {
+				cut_dim = d;
+				cut = box.start[d] + k;
+				cut_distance = distance;
+			}
+		}
+	}
+
+	std::vector<std::array<int, DIM>> lower, upper;
+	for (const auto &f : flagged) (f[cut_dim] < cut ? lower : upper).push_back(f);
+	cluster<DIM>(std::move(lower), efficiency, boxes);
+	cluster<DIM>(std::move(upper), efficiency, boxes);
+}
+}
+
+// just a little helper
+template <int DIM, typename T = double>
+auto amr_level(const int ratio, const int ghosts, std::vector<impl::dense_space<DIM>> patches) {
+	return impl::amr_level<DIM, T>(ratio, ghosts, std::move(patches));
+}
+
+// rebuilds the patches of fine from the coarse points flag(patch, idx) marks. Values are copied from the old
+// fine patches where they overlap the new ones, and prolongated from coarse everywhere else.
+template <int DIM, typename T, typename flagT>
+void regrid(const impl::amr_level<DIM, T> &coarse, impl::amr_level<DIM, T> &fine, flagT &&flag,
+			const double efficiency = 0.7) {
+	std::vector<std::array<int, DIM>> flagged;
+	for (int p = 0; p < int(coarse.patches.size()); ++p)
+		impl::rm_for_each(coarse.patches[p], [&](const std::array<int, DIM> &idx) {
+			if (flag(p, idx)) flagged.push_back(idx);
+		});
+
+	std::vector<impl::dense_space<DIM>> clusters, boxes;
+	impl::cluster<DIM>(std::move(flagged), efficiency, clusters);
+	// a cluster box may span holes between coarse patches, fine patches must be nested in the coarse level
+	for (const auto &c : clusters)
+		for (const auto &patch : coarse.patches) {
+			auto b = impl::intersect(c, patch);
+			if (b.empty()) continue;
+			for (int d = 0; d < DIM; ++d) {
+				b.start[d] *= fine.ratio;
+				b.limit[d] *= fine.ratio;
+			}
+			boxes.push_back(b);
+		}
+	assert(impl::nested(coarse, fine.ratio, boxes));
+
+	impl::amr_level<DIM, T> old(fine);
+	fine.reset(std::move(boxes));
+	for (int p = 0; p < int(fine.patches.size()); ++p) {
+		impl::prolong(coarse, fine, p, fine.patches[p]);
+		for (int q = 0; q < int(old.patches.size()); ++q)
+			impl::rm_for_each(impl::intersect(fine.patches[p], old.patches[q]),
+							  [&](const std::array<int, DIM> &idx) { fine.at(p, idx) = old.at(q, idx); });
+	}
+	impl::fill_ghosts(coarse, fine);
+}
+
+namespace impl {
+template <int DIM> struct block_sparse_space;
+
+// walks the set bits of the active tile bitset
+template <int DIM> struct active_tile_iteration {
+	const block_sparse_space<DIM> *_space;
+	int tile;	   // current tile id
+	int remaining; // active tiles left including the current one
+
+	bool operator!=(const active_tile_iteration<DIM> &rhs) const noexcept { return remaining != rhs.remaining; }
+
+	void operator++() noexcept {
+		if (--remaining > 0) tile = _space->next_active(tile + 1);
+	}
+
+	dense_space<DIM> operator*() const noexcept { return _space->tile_space(tile); }
+};
+
+template <int DIM> struct active_tile_range {
+	const block_sparse_space<DIM> *_space;
+	int first, count; // first active tile and number of active tiles
+
+	auto begin() const noexcept { return active_tile_iteration<DIM>{_space, first, count}; }
+	auto end() const noexcept { return active_tile_iteration<DIM>{_space, first, 0}; }
+};
+
+// a dense_space covered by a coarse grid of tiles, of which only the active ones are iterated
+template <int DIM> struct block_sparse_space {
+	static constexpr int dim = DIM;
+
+	dense_space<DIM> _space;
+	std::array<int, DIM> tile;	// extents of a tile
+	std::array<int, DIM> tiles; // number of tiles per dimension
+
+	block_sparse_space() = delete;
+	block_sparse_space(const block_sparse_space<DIM> &) = default;
+	block_sparse_space(block_sparse_space<DIM> &&) = default;
+
+	block_sparse_space(const dense_space<DIM> &s, const std::array<int, DIM> &t) : _space(s), tile(t) {
+		int count = 1;
+		for (int d = 0; d < DIM; ++d) {
+			tiles[d] = std::max(0, (s.limit[d] - s.start[d] + t[d] - 1) / t[d]);
+			count *= tiles[d];
+		}
+		_active.assign((count + 63) / 64, 0);
+	}
+
+	int tile_count() const noexcept {
+		int count = 1;
+		for (const int t : tiles) count *= t;
+		return count;
+	}
+
+	// the tile containing idx
+	int tile_of(const std::array<int, DIM> &idx) const noexcept {
+		int t = 0;
+		for (int d = 0; d < DIM; ++d) t = t * tiles[d] + (idx[d] - _space.start[d]) / tile[d];
+		return t;
+	}
+
+	// the points of tile t, tiles at the upper end are cut off at the limit of the space
+	dense_space<DIM> tile_space(int t) const noexcept {
+		dense_space<DIM> s(_space);
+		for (int d = DIM - 1; d >= 0; --d) {
+			s.start[d] = _space.start[d] + (t % tiles[d]) * tile[d];
+			s.limit[d] = std::min(_space.limit[d], s.start[d] + tile[d]);
+			t /= tiles[d];
+		}
+		return s;
+	}
+
+	// switching tiles never reallocates, so it is cheap between sweeps
+	void activate(const int t) noexcept {
+		if (active(t)) return;
+		_active[t / 64] |= std::uint64_t(1) << (t % 64);
+		_points += tile_space(t).size();
+	}
+	void deactivate(const int t) noexcept {
+		if (!active(t)) return;
+		_active[t / 64] &= ~(std::uint64_t(1) << (t % 64));
+		_points -= tile_space(t).size();
+	}
+	bool active(const int t) const noexcept { return (_active[t / 64] >> (t % 64)) & 1; }
+	void clear() noexcept {
+		std::fill(_active.begin(), _active.end(), 0);
+		_points = 0;
+	}
+	void activate_all() noexcept {
+		for (int t = 0; t < tile_count(); ++t) activate(t);
+	}
+
+	// points in active tiles
+	std::ptrdiff_t size() const noexcept { return _points; }
+	bool empty() const noexcept { return _points == 0; }
+	bool contains(const std::array<int, DIM> &idx) const noexcept {
+		return _space.contains(idx) && active(tile_of(idx));
+	}
+	// position of idx in the underlying dense_space, active or not
+	std::ptrdiff_t linear_offset(const std::array<int, DIM> &idx) const noexcept { return _space.linear_offset(idx); }
+
+	int active_count() const noexcept {
+		int count = 0;
+		for (const auto w : _active) count += __builtin_popcountll(w);
+		return count;
+	}
+
+	// first active tile with id >= t, tile_count() if there is none
+	int next_active(const int t) const noexcept {
+		int w = t / 64;
+		if (w >= int(_active.size())) return tile_count();
+		std::uint64_t bits = _active[w] & (~std::uint64_t(0) << (t % 64));
+		while (bits == 0) {
+			if (++w == int(_active.size())) return tile_count();
+			bits = _active[w];
+		}
+		return w * 64 + __builtin_ctzll(bits);
+	}
+
+	// the rank-th active tile
+	int select(int rank) const noexcept {
+		int w = 0;
+		for (; w < int(_active.size()); ++w) {
+			const int c = __builtin_popcountll(_active[w]);
+			if (rank < c) break;
+			rank -= c;
+		}
+		if (w == int(_active.size())) return tile_count();
+		std::uint64_t bits = _active[w];
+		for (; rank > 0; --rank) bits &= bits - 1;
+		return w * 64 + __builtin_ctzll(bits);
+	}
+
+	// all active tiles as dense_spaces, each one can be traversed with any order
+	auto active_tiles() const noexcept { return active_tile_range<DIM>{this, next_active(0), active_count()}; }
+
+	// the ranks [first, last) of the active tiles
+	auto active_tiles(const int first, const int last) const noexcept {
+		return active_tile_range<DIM>{this, select(first), std::max(0, last - first)};
+	}
+
+  private:
+	std::vector<std::uint64_t> _active;
+	std::ptrdiff_t _points = 0;
+};
+}
+
+// just a little helper
+template <int DIM>
+auto block_sparse_space(const impl::dense_space<DIM> &space, const decltype(impl::dense_space<DIM>::start) &tile) {
+	return impl::block_sparse_space<DIM>(space, tile);
+}
+
+// the active tiles of the calling thread, every thread gets the same number of active tiles
+template <int DIM> auto tile_partition(const impl::block_sparse_space<DIM> &space) {
+	const auto range = impl::split(0, space.active_count(), omp_get_num_threads(), omp_get_thread_num());
+	return space.active_tiles(range.first, range.second);
+}
+
+// adjacency of an unstructured mesh in compressed sparse row format
+struct csr_graph {
+	std::vector<int> offsets; // neighbours of node n are neighbours[offsets[n] .. offsets[n + 1])
+	std::vector<int> neighbours;
+
+	int nodes() const noexcept { return int(offsets.size()) - 1; }
+	int edges() const noexcept { return int(neighbours.size()); }
+	int degree(const int n) const noexcept { return offsets[n + 1] - offsets[n]; }
+};
+
+namespace impl {
+template <typename T> struct pointer_range {
+	const T *first, *last;
+
+	const T *begin() const noexcept { return first; }
+	const T *end() const noexcept { return last; }
+	int size() const noexcept { return int(last - first); }
+};
+
+// the nodes of a graph as a 1D space, so all orders and partitions apply to it
+struct graph_space : public dense_space<1> {
+	const csr_graph *_graph;
+
+	graph_space() = delete;
+	graph_space(const graph_space &) = default;
+	graph_space(graph_space &&) = default;
+	graph_space &operator=(const graph_space &) = default;
+	graph_space &operator=(graph_space &&) = default;
+
+	graph_space(const csr_graph &g) : dense_space<1>(0, g.nodes()), _graph(&g) {}
+
+	pointer_range<int> neighbours(const int n) const noexcept {
+		const int *base = _graph->neighbours.data();
+		return {base + _graph->offsets[n], base + _graph->offsets[n + 1]};
+	}
+};
+
+// like static_partition, but every thread gets nodes with about the same number of edges
+template <typename spaceT> struct edge_partition : public spaceT {
+	edge_partition() = delete;
+	edge_partition(const edge_partition<spaceT> &) = default;
+	edge_partition(edge_partition<spaceT> &&) = default;
+	edge_partition<spaceT> &operator=(const edge_partition<spaceT> &) = default;
+	edge_partition<spaceT> &operator=(edge_partition<spaceT> &&) = default;
+
+	edge_partition(const spaceT &o) : spaceT(o) { partition(); }
+	edge_partition(spaceT &&o) : spaceT(std::forward<spaceT>(o)) { partition(); }
+
+  private:
+	void partition() noexcept {
+		const int id = omp_get_thread_num();
+		const int threads = omp_get_num_threads();
+		const auto &offsets = spaceT::_graph->offsets;
+		const auto first = offsets.begin() + spaceT::start[0], last = offsets.begin() + spaceT::limit[0];
+		const auto edges = split(*first, *last, threads, id);
+		spaceT::start[0] = int(std::lower_bound(first, last, edges.first) - offsets.begin());
+		spaceT::limit[0] = int(std::lower_bound(first, last, edges.second) - offsets.begin());
+		if (id == threads - 1) spaceT::limit[0] = int(last - offsets.begin());
+	}
+};
+
+inline std::uint64_t spread_bits(std::uint64_t v, const int dims) noexcept {
+	std::uint64_t r = 0;
+	for (int b = 0; b < 64 / dims; ++b) r |= ((v >> b) & 1) << (b * dims);
+	return r;
+}
+}
+
+// just a little helper
+inline auto graph_space(const csr_graph &g) { return impl::graph_space(g); }
+
+template <typename T> auto edge_partition(T &&instance) {
+	return impl::edge_partition<std::decay_t<T>>(std::forward<T>(instance));
+}
+
+#if __cplusplus >= 202002L
+// spaces, orders and partitions are cheap to copy and iterate lazily, i.e. they are views
+namespace std::ranges {
+template <int DIM> inline constexpr bool enable_view<impl::dense_space<DIM>> = true;
+template <> inline constexpr bool enable_view<impl::graph_space> = true;
+template <typename spaceT> inline constexpr bool enable_view<impl::cm_order<spaceT>> = true;
+template <typename spaceT> inline constexpr bool enable_view<impl::rm_order<spaceT>> = true;
+template <typename spaceT> inline constexpr bool enable_view<impl::static_partition<spaceT>> = true;
+template <typename spaceT> inline constexpr bool enable_view<impl::edge_partition<spaceT>> = true;
+}
+#endif
+
+// Reorderings return order with order[new id] = old id.
+
+// reverse Cuthill-McKee: breadth first from a node of minimal degree, lower degree neighbours first
+inline std::vector<int> rcm_order(const csr_graph &g) {
+	const int n = g.nodes();
+	std::vector<int> order, by_degree(n);
+	std::vector<char> visited(n, 0);
+	order.reserve(n);
+	std::iota(by_degree.begin(), by_degree.end(), 0);
+	std::stable_sort(by_degree.begin(), by_degree.end(), [&](int a, int b) { return g.degree(a) < g.degree(b); });
+
+	for (const int root : by_degree) {
+		if (visited[root]) continue;
+		visited[root] = 1;
+		std::size_t head = order.size();
+		order.push_back(root);
+		for (; head < order.size(); ++head) {
+			const int node = order[head];
+			const std::size_t first = order.size();
+			for (int k = g.offsets[node]; k < g.offsets[node + 1]; ++k) {
+				const int m = g.neighbours[k];
+				if (visited[m]) continue;
+				visited[m] = 1;
+				order.push_back(m);
+			}
+			std::stable_sort(order.begin() + first, order.end(), [&](int a, int b) { return g.degree(a) < g.degree(b); });
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+// space-filling curve (Morton) order of the node coordinates
+template <std::size_t DIM> std::vector<int> sfc_order(const std::vector<std::array<double, DIM>> &coords) {
+	static_assert(DIM > 0 && DIM <= 3, "Morton keys are 64 bit, at most 3 dimensions fit.");
+	constexpr int bits = 64 / DIM;
+	constexpr std::uint64_t top = ~std::uint64_t(0) >> (64 - bits); // largest coordinate key, 2^bits - 1
+	std::array<double, DIM> low, high;
+	low.fill(INFINITY);
+	high.fill(-INFINITY);
+	for (const auto &c : coords)
+		for (std::size_t d = 0; d < DIM; ++d) {
+			low[d] = std::min(low[d], c[d]);
+			high[d] = std::max(high[d], c[d]);
+		}
+
+	std::vector<std::uint64_t> keys(coords.size());
+#pragma omp parallel for
+	for (std::size_t n = 0; n < coords.size(); ++n) {
+		std::uint64_t key = 0;
+		for (std::size_t d = 0; d < DIM; ++d) {
+			const double extent = high[d] > low[d] ? high[d] - low[d] : 1;
+			const double scaled = (coords[n][d] - low[d]) / extent * double(top);
+			// double(top) rounds up to 2^64 for a single dimension, which does not convert
+			const std::uint64_t q = scaled >= double(top) ? top : std::uint64_t(scaled);
+			key |= impl::spread_bits(q, DIM) << d;
+		}
+		keys[n] = key;
+	}
+
+	std::vector<int> order(coords.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+	return order;
+}
+
+// the node data in the new order
+template <typename T> std::vector<T> permute(const std::vector<T> &data, const std::vector<int> &order) {
+	std::vector<T> result(order.size());
+#pragma omp parallel for
+	for (std::size_t n = 0; n < order.size(); ++n) result[n] = data[order[n]];
+	return result;
+}
+
+// the graph with nodes renumbered to the new order
+inline csr_graph permute(const csr_graph &g, const std::vector<int> &order) {
+	std::vector<int> new_id(order.size());
+	for (std::size_t n = 0; n < order.size(); ++n) new_id[order[n]] = int(n);
+
+	csr_graph result;
+	result.offsets.assign(1, 0);
+	result.neighbours.reserve(g.neighbours.size());
+	for (const int old : order) {
+		const std::size_t first = result.neighbours.size();
+		for (int k = g.offsets[old]; k < g.offsets[old + 1]; ++k) result.neighbours.push_back(new_id[g.neighbours[k]]);
+		std::sort(result.neighbours.begin() + first, result.neighbours.end());
+		result.offsets.push_back(int(result.neighbours.size()));
+	}
+	return result;
+}
+
+namespace impl {
+inline void put_varint(std::vector<std::uint8_t> &bytes, std::uint64_t v) {
+	for (; v >= 0x80; v >>= 7) bytes.push_back(std::uint8_t(v | 0x80));
+	bytes.push_back(std::uint8_t(v));
+}
+
+inline std::uint64_t get_varint(const std::uint8_t *&p) noexcept {
+	std::uint64_t v = 0;
+	for (int shift = 0;; shift += 7) {
+		const std::uint8_t b = *p++;
+		v |= std::uint64_t(b & 0x7f) << shift;
+		if (b < 0x80) return v;
+	}
+}
+
+inline std::uint64_t zigzag(const std::int64_t v) noexcept { return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63); }
+inline std::int64_t unzigzag(const std::uint64_t v) noexcept { return std::int64_t(v >> 1) ^ -std::int64_t(v & 1); }
+
+template <int DIM> struct materialized_order;
+
+template <int DIM> struct materialized_iteration {
+	std::array<int, DIM> index;
+	const std::uint8_t *next; // the header of the next run
+	int remaining;			  // points left in the current run, including the current one
+	int run_dim;
+
+	bool operator!=(const materialized_iteration<DIM> &rhs) const noexcept {
+		return next != rhs.next || remaining != rhs.remaining;
+	}
+
+	void operator++() noexcept {
+		if (--remaining > 0)
+			++index[run_dim];
+		else if (next != _end)
+			decode();
+	}
+
+	auto operator*() const noexcept { return impl::array_to_tuple<DIM, decltype(index)>::get(index); }
+
+  private:
+	friend struct materialized_order<DIM>;
+	const std::uint8_t *_end;
+	std::array<int, DIM> _run_start;
+
+	void decode() noexcept {
+		const std::uint64_t header = get_varint(next);
+		run_dim = int(header % DIM);
+		remaining = int(header / DIM) + 1;
+		for (int d = 0; d < DIM; ++d) _run_start[d] += int(unzigzag(get_varint(next)));
+		index = _run_start;
+	}
+};
+
+// The visiting sequence of an order, recorded once and replayed cheaply. The sequence is stored as runs of
+// unit steps along one dimension, every run as varints: (length - 1) * DIM + dimension, then the zigzag
+// encoded distance of its first point from the first point of the previous run.
+template <int DIM> struct materialized_order {
+	std::vector<std::uint8_t> _bytes;
+	long _points = 0;
+
+	materialized_order() = default;
+
+	// non-const, generators are consumed by traversing them
+	template <typename orderT,
+			  typename = std::enable_if_t<!std::is_same<std::decay_t<orderT>, materialized_order<DIM>>::value>>
+	explicit materialized_order(orderT &&order) {
+		std::array<int, DIM> run_start{}, previous_start{}, last{};
+		int run_dim = 0, length = 0;
+		for (auto it = order.begin(), end = order.end(); it != end; ++it) {
+			const std::array<int, DIM> &idx = it.index;
+			++_points;
+			if (length > 0) {
+				// does idx continue the current run?
+				int step = -1, differing = 0;
+				for (int d = 0; d < DIM; ++d)
+					if (idx[d] != last[d]) {
+						++differing;
+						step = d;
+					}
+				if (differing == 1 && idx[step] == last[step] + 1 && (length == 1 || step == run_dim)) {
+					run_dim = step;
+					++length;
+					last = idx;
+					continue;
+				}
+				flush(run_start, previous_start, run_dim, length);
+			}
+			run_start = last = idx;
+			run_dim = 0;
+			length = 1;
+		}
+		if (length > 0) flush(run_start, previous_start, run_dim, length);
+		_bytes.shrink_to_fit();
+	}
+
+	long points() const noexcept { return _points; }
+	std::ptrdiff_t size() const noexcept { return _points; }
+	bool empty() const noexcept { return _points == 0; }
+
+	// memory used by the recording
+	std::size_t bytes() const noexcept { return _bytes.capacity() + sizeof(*this); }
+
+	auto begin() const noexcept {
+		materialized_iteration<DIM> temp = end();
+		temp.next = _bytes.data();
+		if (!_bytes.empty()) temp.decode();
+		return temp;
+	}
+
+	auto end() const noexcept {
+		materialized_iteration<DIM> temp;
+		temp.index.fill(0);
+		temp._run_start.fill(0);
+		temp.next = temp._end = _bytes.data() + _bytes.size();
+		temp.remaining = 0;
+		temp.run_dim = 0;
+		return temp;
+	}
+
+  private:
+	void flush(const std::array<int, DIM> &run_start, std::array<int, DIM> &previous_start, const int run_dim,
+			   const int length) {
+		put_varint(_bytes, std::uint64_t(length - 1) * DIM + run_dim);
+		for (int d = 0; d < DIM; ++d) put_varint(_bytes, zigzag(std::int64_t(run_start[d]) - previous_start[d]));
+		previous_start = run_start;
+	}
+};
+
+// one materialized order per thread, recorded the first time the thread asks for it
+template <int DIM> struct materialized_slabs {
+	materialized_slabs() = default;
+
+	// Call inside of the parallel region, make_order() builds the (partitioned) order of the calling thread. The
+	// slabs grow with the team, which may be larger than omp_get_max_threads() said when this was built. A slab is
+	// recorded again once the team size changed, which invalidates the order the thread got before.
+	template <typename F> const materialized_order<DIM> &get(F &&make_order) {
+		const std::size_t id = omp_get_thread_num();
+		const int team = omp_get_num_threads();
+		recording current;
+#pragma omp critical(materialized_slabs)
+		{
+			if (_slabs.size() <= id) _slabs.resize(id + 1);
+			current = {_slabs[id].order.get(), _slabs[id].team};
+		}
+		if (current.order && current.team == team) return *current.order;
+		auto recorded = std::make_unique<materialized_order<DIM>>(make_order());
+		const materialized_order<DIM> *slab = recorded.get();
+#pragma omp critical(materialized_slabs)
+		_slabs[id] = {std::move(recorded), team};
+		return *slab;
+	}
+
+	std::size_t bytes() const noexcept {
+		std::size_t b = 0;
+		for (const auto &s : _slabs)
+			if (s.order) b += s.order->bytes();
+		return b;
+	}
+
+  private:
+	template <typename P> struct slot {
+		P order;
+		int team; // the size of the team the order was recorded for
+	};
+	using recording = slot<const materialized_order<DIM> *>;
+	std::vector<slot<std::unique_ptr<materialized_order<DIM>>>> _slabs; // orders stay put while the vector grows
+};
+}
+
+// just a little helper
+template <typename T> auto materialize(T &&order) {
+	return impl::materialized_order<std::tuple_size<decltype(order.begin().index)>::value>(std::forward<T>(order));
+}
+
+#if defined(__cpp_impl_coroutine)
+namespace impl {
+// Coroutine frames of finished traversals are kept per thread and handed out again to the next one of the same
+// size, so restarting a traversal does not touch the heap.
+struct frame_pool {
+	struct alignas(alignof(std::max_align_t)) header {
+		header *next;
+		std::size_t size;
+	};
+
+	static void *allocate(const std::size_t size) {
+		for (header **h = &free_list(); *h; h = &(*h)->next)
+			if ((*h)->size == size) {
+				header *block = *h;
+				*h = block->next;
+				return block + 1;
+			}
+		header *block = static_cast<header *>(::operator new(sizeof(header) + size));
+		block->size = size;
+		return block + 1;
+	}
+
+	static void deallocate(void *p) noexcept {
+		header *block = static_cast<header *>(p) - 1;
+		block->next = free_list();
+		free_list() = block;
+	}
+
+	static header *&free_list() noexcept {
+		static thread_local header *head = nullptr;
+		return head;
+	}
+};
+
+template <int DIM> struct order_generator;
+
+template <int DIM> struct generator_iteration {
+	using handle_type = std::coroutine_handle<typename order_generator<DIM>::promise_type>;
+
+	std::array<int, DIM> index;
+	handle_type _handle; // empty for the end iteration
+
+	bool operator!=(const generator_iteration<DIM> &rhs) const noexcept { return done() != rhs.done(); }
+
+	void operator++() {
+		_handle.resume();
+		if (!_handle.done()) index = _handle.promise().index;
+	}
+
+	auto operator*() const noexcept { return impl::array_to_tuple<DIM, decltype(index)>::get(index); }
+
+	bool done() const noexcept { return !_handle || _handle.done(); }
+};
+
+// A lazily evaluated order written as a coroutine, e.g.
+//   order_generator<2> diagonal(int n) {
+//       for (int k = 0; k < n; ++k)
+//           for (int i = 0; i <= k; ++i) co_yield {{i, k - i}};
+//   }
+// It can be traversed once, with the same interface as the other orders.
+template <int DIM> struct order_generator {
+	struct promise_type {
+		std::array<int, DIM> index;
+
+		order_generator<DIM> get_return_object() noexcept {
+			return order_generator<DIM>(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		std::suspend_always final_suspend() const noexcept { return {}; }
+		std::suspend_always yield_value(const std::array<int, DIM> &idx) noexcept {
+			index = idx;
+			return {};
+		}
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+
+		static void *operator new(const std::size_t size) { return frame_pool::allocate(size); }
+		static void operator delete(void *p) noexcept { frame_pool::deallocate(p); }
+	};
+
+	order_generator() = delete;
+	order_generator(const order_generator<DIM> &) = delete;
+	order_generator(order_generator<DIM> &&o) noexcept : _handle(o._handle) { o._handle = nullptr; }
+	explicit order_generator(std::coroutine_handle<promise_type> h) noexcept : _handle(h) {}
+
+	~order_generator() {
+		if (_handle) _handle.destroy();
+	}
+
+	auto begin() {
+		generator_iteration<DIM> temp{{}, _handle};
+		++temp;
+		return temp;
+	}
+
+	auto end() const noexcept { return generator_iteration<DIM>{{}, nullptr}; }
+
+  private:
+	std::coroutine_handle<promise_type> _handle;
+};
+}
+
+template <int DIM> using order_generator = impl::order_generator<DIM>;
+
+// rm_order written as a coroutine, mostly to compare both ways of writing an order
+template <int DIM> order_generator<DIM> rm_generator(const impl::dense_space<DIM> space) {
+	for (int d = 0; d < DIM; ++d)
+		if (space.start[d] >= space.limit[d]) co_return;
+	std::array<int, DIM> idx = space.start;
+	for (;;) {
+		co_yield idx;
+		int d = DIM - 1;
+		for (; d >= 0; --d) {
+			if (++idx[d] < space.limit[d]) break;
+			idx[d] = space.start[d];
+		}
+		if (d < 0) co_return;
+	}
+}
+#endif
+
+// time per point of the different ways to traverse the same space
+inline void bench_orders() {
+	const auto space = dense_space(0, 1000, 0, 1000);
+	const double points = 1000.0 * 1000.0;
+	long sink = 0;
+	auto report = [&](const char *name, const double time) {
+		std::cout << name << ": " << time / points * 1e9 << " ns/point" << std::endl;
+	};
+	auto traverse = [&](auto &&order) {
+		for (const auto &iteration : order) sink += std::get<1>(iteration);
+	};
+
+	report("rm_order", best_time([&] { traverse(rm_order(space)); }));
+	report("nested loops", best_time([&] {
+			   impl::rm_for_each(space, [&](const std::array<int, 2> &idx) { sink += idx[1]; });
+		   }));
+	const auto recorded = materialize(rm_order(space));
+	report("materialized rm_order", best_time([&] { traverse(recorded); }));
+#if defined(__cpp_impl_coroutine)
+	report("rm_generator", best_time([&] { traverse(rm_generator(space)); }));
+#endif
+	if (sink == 42) std::cout << std::endl;
+}
+
+// how scatter kernels resolve conflicting writes of neighbouring threads
+enum class scatter_mode { privatize, atomic };
+
+namespace impl {
+// a thread's view of a scatter_output, only valid between bind() and merge()
+template <int DIM, typename T> struct scatter_accessor {
+	grid<DIM, precision<T, T>> _grid;
+	int start, limit, radius; // the thread's rows of dimension 0 and how far its writes may reach beyond them
+	T *lower, *upper;		  // private rows [start - radius, start + radius) and [limit - radius, limit + radius)
+	bool atomic;
+
+	template <typename... idxT> void add(const T v, const idxT... idx) noexcept {
+		static_assert(sizeof...(idx) == DIM, "Wrong number of indices for scatter_output.");
+		const std::array<int, DIM> i{{idx...}};
+		assert(i[0] >= start - radius && i[0] < limit + radius);
+		if (atomic) {
+			T &target = *_grid.data(i);
+#pragma omp atomic
+			target += v;
+		} else if (lower && i[0] < start + radius) {
+			lower[band_offset(i, start - radius)] += v;
+		} else if (upper && i[0] >= limit - radius) {
+			upper[band_offset(i, limit - radius)] += v;
+		} else {
+			*_grid.data(i) += v;
+		}
+	}
+
+  private:
+	std::ptrdiff_t band_offset(std::array<int, DIM> i, const int first_row) const noexcept {
+		i[0] -= first_row;
+		return _grid.offset(i);
+	}
+};
+
+// Output grid of a scatter kernel, i.e. one that adds into the neighbourhood of each point, run over
+// static_partition slabs of dimension 0. With scatter_mode::privatize every thread adds the rows within radius of
+// its slab boundaries into private buffers, which merge() adds to the grid, one boundary per thread. All other
+// rows are owned by exactly one thread and written directly. scatter_mode::atomic uses atomic adds everywhere.
+template <int DIM, typename T> struct scatter_output {
+	grid<DIM, precision<T, T>> _grid;
+	int radius;
+	scatter_mode mode;
+
+	scatter_output() = delete;
+	scatter_output(const grid<DIM, precision<T, T>> &g, const int r, const scatter_mode m)
+		: _grid(g), radius(r), mode(m) {}
+
+	// Call with the slab of the calling thread, by all threads of the parallel region. Privatization needs slabs of
+	// at least 2 * radius rows, thinner ones switch the whole team to atomics.
+	template <typename spaceT> scatter_accessor<DIM, T> bind(const spaceT &slab) {
+		const int id = omp_get_thread_num(), threads = omp_get_num_threads();
+#pragma omp single
+		{
+			_slabs.resize(threads);
+			_below.resize(threads);
+			_lower.resize(threads);
+			_upper.resize(threads);
+		}
+		_slabs[id] = {{slab.start[0], slab.limit[0]}};
+#pragma omp barrier
+		bool atomic = mode == scatter_mode::atomic;
+		for (int t = 0; t < threads; ++t) atomic = atomic || _slabs[t][1] - _slabs[t][0] < 2 * radius;
+
+		// neighbours own the adjacent slabs, which need not be the adjacent thread ids
+		int above = -1;
+		_below[id] = -1;
+		for (int t = 0; t < threads; ++t) {
+			if (t != id && _slabs[t][1] == _slabs[id][0]) _below[id] = t;
+			if (t != id && _slabs[t][0] == _slabs[id][1]) above = t;
+		}
+
+		scatter_accessor<DIM, T> a{_grid, slab.start[0], slab.limit[0], radius, nullptr, nullptr, atomic};
+		_lower[id].clear(); // merge() skips boundaries without buffers
+		_upper[id].clear();
+		if (!atomic && radius > 0) {
+			const std::size_t band = std::size_t(2 * radius) * row_size();
+			// the outermost boundaries of the space have no neighbour to race with
+			if (_below[id] >= 0) a.lower = zeroed(_lower[id], band);
+			if (above >= 0) a.upper = zeroed(_upper[id], band);
+		}
+		return a;
+	}
+
+	// adds the private rows to the grid, by all threads of the parallel region
+	void merge() {
+		const int id = omp_get_thread_num(), below = _below[id];
+#pragma omp barrier
+		if (below >= 0 && !_lower[id].empty() && !_upper[below].empty()) {
+			std::array<int, DIM> first{};
+			first[0] = _slabs[id][0] - radius;
+			T *dst = _grid.data(first);
+			const T *lower = _lower[id].data(), *upper = _upper[below].data();
+			const std::ptrdiff_t n = std::ptrdiff_t(2 * radius) * row_size();
+#pragma omp simd
+			for (std::ptrdiff_t k = 0; k < n; ++k) dst[k] += lower[k] + upper[k];
+		}
+#pragma omp barrier
+	}
+
+  private:
+	std::vector<std::array<int, 2>> _slabs;
+	std::vector<int> _below; // the thread owning the slab below, -1 if none
+	std::vector<std::vector<T>> _lower, _upper;
+
+	std::size_t row_size() const noexcept {
+		std::size_t n = 1;
+		for (int d = 1; d < DIM; ++d) n *= _grid.extent[d];
+		return n;
+	}
+
+	// buffers are kept between sweeps and first touched by the thread using them
+	static T *zeroed(std::vector<T> &buffer, const std::size_t n) {
+		buffer.assign(n, T());
+		return buffer.data();
+	}
+};
+}
+
+// just a little helper
+template <int DIM, typename T>
+auto scatter_output(const impl::grid<DIM, impl::precision<T, T>> &g, const int radius,
+					const scatter_mode mode = scatter_mode::privatize) {
+	return impl::scatter_output<DIM, T>(g, radius, mode);
+}
+
+namespace impl {
+// Active tiles of a block_sparse_space grouped into colours, such that the write footprints (tile grown by radius)
+// of two tiles of the same colour never overlap. Tiles conflict up to ceil(2 * radius / tile) tiles apart, so the
+// colour of a tile is its tile index modulo that distance plus one, per dimension.
+template <int DIM> struct tile_colouring {
+	std::vector<std::vector<int>> colours; // active tile ids per colour
+
+	tile_colouring() = delete;
+	tile_colouring(const tile_colouring<DIM> &) = default;
+	tile_colouring(tile_colouring<DIM> &&) = default;
+
+	tile_colouring(const block_sparse_space<DIM> &space, const int radius) {
+		std::array<int, DIM> period;
+		int count = 1;
+		for (int d = 0; d < DIM; ++d) {
+			period[d] = (2 * radius + space.tile[d] - 1) / space.tile[d] + 1;
+			count *= period[d];
+		}
+		colours.resize(count);
+		for (int t = space.next_active(0); t < space.tile_count(); t = space.next_active(t + 1))
+			colours[colour_of(space, period, t)].push_back(t);
+	}
+
+  private:
+	static int colour_of(const block_sparse_space<DIM> &space, const std::array<int, DIM> &period, int t) noexcept {
+		std::array<int, DIM> idx;
+		for (int d = DIM - 1; d >= 0; --d) {
+			idx[d] = t % space.tiles[d];
+			t /= space.tiles[d];
+		}
+		int c = 0;
+		for (int d = 0; d < DIM; ++d) c = c * period[d] + idx[d] % period[d];
+		return c;
+	}
+};
+}
+
+// just a little helper
+template <int DIM> auto tile_colouring(const impl::block_sparse_space<DIM> &space, const int radius) {
+	return impl::tile_colouring<DIM>(space, radius);
+}
+
+// Runs kernel(i, j, ...) over all active tiles, one colour after the other. The tiles of a colour are split evenly
+// across the team and traversed with orderT, a barrier separates the colours. Call inside of a parallel region.
+template <template <typename> class orderT = impl::rm_order, int DIM, typename kernelT>
+void coloured_for_each(const impl::block_sparse_space<DIM> &space, const impl::tile_colouring<DIM> &colouring,
+					   kernelT &&kernel) {
+	const int id = omp_get_thread_num(), threads = omp_get_num_threads();
+	for (const auto &tiles : colouring.colours) {
+		if (tiles.empty()) continue;
+		const auto mine = impl::split(0, int(tiles.size()), threads, id);
+		for (int k = mine.first; k < mine.second; ++k) {
+			const orderT<impl::dense_space<DIM>> order(space.tile_space(tiles[k]));
+			for (auto it = order.begin(), end = order.end(); it != end; ++it)
+				impl::apply_index(kernel, it.index, std::make_index_sequence<DIM>());
+		}
+#pragma omp barrier
+	}
+}
+
+// The first point of space, in traversal order, for which pred(i, j, ...) holds. make_order(space) builds the
+// calling thread's order inside of the parallel region, the traversal order is that of thread 0, then thread 1 and
+// so on, e.g. rm_order(static_partition(0, space)). A thread stops as soon as an earlier thread found a match,
+// since nothing it could find would come first.
+template <typename spaceT, typename makeT, typename predT>
+std::pair<bool, std::array<int, spaceT::dim>> parallel_find_if(const spaceT &space, makeT &&make_order, predT &&pred) {
+	constexpr int DIM = spaceT::dim;
+	std::vector<std::pair<bool, std::array<int, DIM>>> found(omp_get_max_threads());
+	std::atomic<int> first_thread(int(found.size())); // earliest thread with a match
+
+#pragma omp parallel
+	{
+		const int id = omp_get_thread_num();
+		const auto order = make_order(space);
+		for (auto it = order.begin(), end = order.end(); it != end; ++it) {
+			if (first_thread.load(std::memory_order_relaxed) < id) break;
+			if (impl::apply_index(pred, it.index, std::make_index_sequence<DIM>())) {
+				found[id] = {true, it.index};
+				int current = first_thread.load();
+				while (id < current && !first_thread.compare_exchange_weak(current, id)) {
+				}
+				break;
+			}
+		}
+	}
+
+	const int first = first_thread.load();
+	if (first < int(found.size())) return found[first];
+	return {false, {}};
+}
+
+template <typename spaceT, typename predT>
+std::pair<bool, std::array<int, spaceT::dim>> parallel_find_if(const spaceT &space, predT &&pred) {
+	return parallel_find_if(space, [](const spaceT &s) { return rm_order(static_partition(0, s)); },
+							std::forward<predT>(pred));
+}
+
+template <typename spaceT, typename predT> bool parallel_any_of(const spaceT &space, predT &&pred) {
+	return parallel_find_if(space, std::forward<predT>(pred)).first;
+}
+
+template <typename spaceT, typename predT> bool parallel_all_of(const spaceT &space, predT &&pred) {
+	return !parallel_find_if(space, [&](const auto... idx) { return !pred(idx...); }).first;
+}
+
+namespace impl {
+// Blocked two-pass scan over the threads' orders: every thread sums value over its part, the sums of the
+// earlier threads give its offset, then it traverses its part again and passes the running prefix to store.
+// between(total) runs on a single thread between the passes.
+template <typename T, typename spaceT, typename makeT, typename valueT, typename betweenT, typename storeT>
+T two_pass_scan(const spaceT &space, makeT &&make_order, valueT &&value, betweenT &&between, storeT &&store) {
+	constexpr int DIM = spaceT::dim;
+	std::vector<T> sums(omp_get_max_threads() + 1, T());
+
+#pragma omp parallel
+	{
+		const int id = omp_get_thread_num(), threads = omp_get_num_threads();
+		const auto order = make_order(space);
+		T sum = T();
+		for (auto it = order.begin(), end = order.end(); it != end; ++it)
+			sum += apply_index(value, it.index, std::make_index_sequence<DIM>());
+		sums[id + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+		{
+			for (int t = 1; t <= threads; ++t) sums[t] += sums[t - 1];
+			between(sums[threads]);
+		}
+		T prefix = sums[id];
+		for (auto it = order.begin(), end = order.end(); it != end; ++it) {
+			const T v = apply_index(value, it.index, std::make_index_sequence<DIM>());
+			apply_index(store, it.index, std::make_index_sequence<DIM>(), prefix);
+			prefix += v;
+		}
+#pragma omp barrier
+#pragma omp single
+		sums[0] = sums[threads];
+	}
+	return sums[0];
+}
+}
+
+// Exclusive prefix sum of value(i, j, ...) over space in traversal order, store(prefix, i, j, ...) gets the sum of
+// the values of all earlier points. make_order is the same as for parallel_find_if. Returns the total.
+template <typename T, typename spaceT, typename makeT, typename valueT, typename storeT>
+T parallel_exclusive_scan(const spaceT &space, makeT &&make_order, valueT &&value, storeT &&store) {
+	return impl::two_pass_scan<T>(space, std::forward<makeT>(make_order), std::forward<valueT>(value), [](const T &) {},
+								  std::forward<storeT>(store));
+}
+
+// project(i, j, ...) of the points for which mask(i, j, ...) holds, densely packed in traversal order
+template <typename spaceT, typename makeT, typename maskT, typename projectT>
+auto parallel_compact(const spaceT &space, makeT &&make_order, maskT &&mask, projectT &&project) {
+	constexpr int DIM = spaceT::dim;
+	using value_type = std::decay_t<decltype(impl::apply_index(project, std::array<int, DIM>(),
+															   std::make_index_sequence<DIM>()))>;
+	std::vector<value_type> result;
+	impl::two_pass_scan<std::ptrdiff_t>(
+		space, std::forward<makeT>(make_order),
+		[&](const auto... idx) -> std::ptrdiff_t { return mask(idx...) ? 1 : 0; },
+		[&](const std::ptrdiff_t total) { result.resize(total); },
+		[&](const std::ptrdiff_t prefix, const auto... idx) {
+			if (mask(idx...)) result[prefix] = project(idx...);
+		});
+	return result;
+}
+
+// the coordinates of the points for which mask(i, j, ...) holds, in row-major order
+template <typename spaceT, typename maskT> auto parallel_compact(const spaceT &space, maskT &&mask) {
+	return parallel_compact(
+		space, [](const spaceT &s) { return rm_order(static_partition(0, s)); }, std::forward<maskT>(mask),
+		[](const auto... idx) { return std::array<int, spaceT::dim>{{idx...}}; });
+}
+
+namespace impl {
+// a thread's own subgrid: its slab grown by the ghost width in every dimension
+template <int DIM, typename T> struct private_subgrid {
+	dense_space<DIM> slab, box;
+	T *_data;
+	std::ptrdiff_t _field_size;
+
+	// idx in global coordinates, inside the slab or its ghost layer
+	T &at(const int field, const std::array<int, DIM> &idx) const noexcept {
+		return _data[field * _field_size + box.linear_offset(idx)];
+	}
+};
+
+// Every thread owns a separately allocated subgrid for its slab of dimension 0 plus ghost layers, so there is no
+// false sharing at slab boundaries. The subgrid is allocated and first touched by its thread, which places it on
+// that thread's NUMA node. exchange() refreshes the dimension 0 ghost rows by copying from the neighbours, ghosts
+// at the boundary of the global space are left to the caller.
+template <int DIM, typename T = double> struct private_subgrids {
+	int ghosts;
+	int fields; // arrays per subgrid, e.g. 2 to double buffer
+
+	private_subgrids() = delete;
+	private_subgrids(const int g, const int f) : ghosts(g), fields(f) {}
+
+	// Call with the slab of the calling thread, by all threads of the parallel region. The subgrid is kept as long
+	// as the slab and the size of the team do not change.
+	template <typename spaceT> private_subgrid<DIM, T> bind(const spaceT &slab) {
+		const int id = omp_get_thread_num();
+#pragma omp single
+		if (int(_grids.size()) != omp_get_num_threads()) _grids = std::vector<owned>(omp_get_num_threads());
+		auto &g = _grids[id];
+		const dense_space<DIM> s(slab.start, slab.limit);
+		if (g.slab != s || g.fields != fields) {
+			g.slab = s;
+			g.fields = fields;
+			g.data.assign(std::size_t(fields) * grow(s, ghosts).size(), T());
+		}
+		g.published.store(0);
+		g.copied.store(0);
+#pragma omp barrier
+		// The neighbours own the rows of the ghost layer, which need not be the adjacent thread ids. Slabs thinner
+		// than the ghost layer make that more than one per side. Being in each other's ghost layer is mutual.
+		g.neighbours.clear();
+		for (int t = 0; t < int(_grids.size()) && !s.empty(); ++t) {
+			const dense_space<DIM> &other = _grids[t].slab;
+			if (t != id && !other.empty() && other.start[0] < s.limit[0] + ghosts &&
+				other.limit[0] > s.start[0] - ghosts)
+				g.neighbours.push_back(t);
+		}
+		return view(id);
+	}
+
+	// refreshes the ghost rows of field from the neighbouring threads, by all threads of the parallel region
+	void exchange(const int field) {
+#pragma omp barrier
+		copy_ghosts(field);
+#pragma omp barrier
+	}
+
+	// Split-phase exchange, for computing the interior while the ghosts are refreshed. Call start_exchange() once
+	// the thread finished writing field, then work on what does not need the ghosts, then finish_exchange(field).
+	// Threads only wait for their neighbours, not for the whole team.
+	void start_exchange() noexcept {
+		const int id = omp_get_thread_num();
+		const int step = _grids[id].published.fetch_add(1, std::memory_order_release) + 1;
+		// writing the other field is only safe once the neighbours copied from it in the previous step
+		for_neighbours(id, [&](owned &n) { spin_until(n.copied, step - 1); });
+	}
+
+	void finish_exchange(const int field) noexcept {
+		const int id = omp_get_thread_num();
+		const int step = _grids[id].published.load(std::memory_order_relaxed);
+		for_neighbours(id, [&](owned &n) { spin_until(n.published, step); });
+		copy_ghosts(field);
+		_grids[id].copied.store(step, std::memory_order_release);
+	}
+
+	// what exchange() does between its barriers
+	void copy_ghosts(const int field) const noexcept {
+		const int id = omp_get_thread_num();
+		const private_subgrid<DIM, T> mine = view(id);
+		for (const int n : _grids[id].neighbours) {
+			copy_rows(view(n), mine, field, mine.slab.start[0] - ghosts, mine.slab.start[0]);
+			copy_rows(view(n), mine, field, mine.slab.limit[0], mine.slab.limit[0] + ghosts);
+		}
+	}
+
+	private_subgrid<DIM, T> view(const int id) const noexcept {
+		auto &g = _grids[id];
+		const dense_space<DIM> box = grow(g.slab, ghosts);
+		return {g.slab, box, const_cast<T *>(g.data.data()), box.size()};
+	}
+
+  private:
+	struct owned {
+		dense_space<DIM> slab;
+		int fields = 0;
+		std::vector<T> data;
+		std::atomic<int> published{0}, copied{0}; // split-phase exchange steps
+		std::vector<int> neighbours;			  // the threads owning rows of the ghost layer
+	};
+	std::vector<owned> _grids;
+
+	template <typename F> void for_neighbours(const int id, F &&f) noexcept {
+		for (const int n : _grids[id].neighbours) f(_grids[n]);
+	}
+
+	static void spin_until(const std::atomic<int> &counter, const int value) noexcept {
+		while (counter.load(std::memory_order_acquire) < value) std::this_thread::yield();
+	}
+
+	// rows [first, last) of dimension 0, as far as the source owns them, ghost columns included. Ghost rows of the
+	// source are left out, they may be refreshed at the same time.
+	static void copy_rows(const private_subgrid<DIM, T> &from, const private_subgrid<DIM, T> &to, const int field,
+						  const int first, const int last) noexcept {
+		dense_space<DIM> rows = intersect(from.box, to.box);
+		rows.start[0] = std::max({rows.start[0], first, from.slab.start[0]});
+		rows.limit[0] = std::max(rows.start[0], std::min({rows.limit[0], last, from.slab.limit[0]}));
+		if (rows.empty()) return;
+		bool contiguous = true; // whole rows of the same width in both
+		for (int d = 1; d < DIM; ++d)
+			contiguous = contiguous && from.box.start[d] == to.box.start[d] && from.box.limit[d] == to.box.limit[d];
+		if (contiguous) {
+			std::memcpy(&to.at(field, rows.start), &from.at(field, rows.start), sizeof(T) * rows.size());
+			return;
+		}
+		rm_for_each(rows, [&](const std::array<int, DIM> &idx) { to.at(field, idx) = from.at(field, idx); });
+	}
+};
+}
+
+// just a little helper
+template <int DIM, typename T = double> auto private_subgrids(const int ghosts, const int fields) {
+	return impl::private_subgrids<DIM, T>(ghosts, fields);
+}
+
+// Split-phase sweep over space, e.g. a thread's slab: start() kicks off the halo refresh, kernel(i, j, ...) runs on
+// the interior that is at least halo[d] away from the boundary of space in every dimension d, then finish() waits
+// for the refresh and the kernel runs on the remaining boundary strips.
+template <typename spaceT, typename startT, typename finishT, typename kernelT>
+void overlapped_sweep(const spaceT &space, const std::array<int, spaceT::dim> &halo, startT &&start, finishT &&finish,
+					  kernelT &&kernel) {
+	constexpr int DIM = spaceT::dim;
+	const impl::dense_space<DIM> box(space.start, space.limit);
+	auto call = [&](const std::array<int, DIM> &idx) {
+		impl::apply_index(kernel, idx, std::make_index_sequence<DIM>());
+	};
+
+	start();
+	impl::rm_for_each(box.interior(halo), call);
+	finish();
+	for (const auto &strip : box.boundary(halo)) impl::rm_for_each(strip, call);
+}
+
+namespace impl {
+// a grid a fused stage reads, and at which offset from the point it computes
+template <int DIM> struct access {
+	const void *grid;
+	std::array<int, DIM> offset;
+};
+
+// Consecutive kernels over the same space, e.g. update, boundary, statistics, run as one traversal of dimension 0
+// slices: for every slice each stage runs in turn, so the data of a slice is still in cache for the next stage.
+// Legality comes from what the stages declare: a stage reading the output of an earlier one at a positive offset
+// in dimension 0 lags that many slices behind it (skew), and near the edges of the slab it is deferred until the
+// neighbouring slabs are done. A stage overwriting what an earlier stage reads in another slice cannot be fused,
+// it starts a new group behind a barrier.
+template <int DIM> struct fused_loop {
+	fused_loop() = default;
+
+	// kernel(i, j, ...) writes the grids in writes and reads the grids in reads at the given offsets
+	template <typename kernelT>
+	fused_loop &add(kernelT &&kernel, std::vector<const void *> writes, std::vector<access<DIM>> reads = {}) {
+		auto k = std::forward<kernelT>(kernel);
+		_stages.push_back({[k](const dense_space<DIM> &slice) mutable {
+							   rm_for_each(slice, [&](const std::array<int, DIM> &idx) {
+								   apply_index(k, idx, std::make_index_sequence<DIM>());
+							   });
+						   },
+						   std::move(writes), std::move(reads), 0, 0, 0});
+		_planned = false;
+		return *this;
+	}
+
+	// the group stage s was planned into, the stages of a group share one traversal
+	int group_of(const int s) {
+		plan();
+		return _stages[s].group;
+	}
+
+	// Runs all stages over slab, the part of the space of the calling thread, e.g. a static_partition along
+	// dimension 0. Call by all threads of the parallel region.
+	template <typename spaceT> void run(const spaceT &slab) {
+#pragma omp single
+		plan();
+		const dense_space<DIM> box(slab.start, slab.limit);
+		for (std::size_t first = 0; first < _stages.size();) {
+			std::size_t last = first;
+			while (last < _stages.size() && _stages[last].group == _stages[first].group) ++last;
+			run_group(box, first, last);
+			first = last;
+#pragma omp barrier
+		}
+	}
+
+  private:
+	struct stage {
+		std::function<void(const dense_space<DIM> &)> sweep;
+		std::vector<const void *> writes;
+		std::vector<access<DIM>> reads;
+		int group, skew, defer; // slices behind the first stage, slices left to the edges of the slab
+	};
+	std::vector<stage> _stages;
+	bool _planned = false;
+
+	static bool writes_to(const stage &s, const void *grid) noexcept {
+		return std::find(s.writes.begin(), s.writes.end(), grid) != s.writes.end();
+	}
+
+	void plan() {
+		if (_planned) return;
+		std::size_t first = 0; // first stage of the current group
+		for (std::size_t s = 0; s < _stages.size(); ++s) {
+			auto &st = _stages[s];
+			bool fusable = s > 0;
+			for (std::size_t e = first; fusable && e < s; ++e)
+				for (const auto &r : _stages[e].reads)
+					if (r.offset[0] != 0 && writes_to(st, r.grid)) fusable = false;
+			if (!fusable) {
+				first = s;
+				st.group = s == 0 ? 0 : _stages[s - 1].group + 1;
+				st.skew = st.defer = 0;
+				continue;
+			}
+			const auto &prev = _stages[s - 1];
+			st.group = prev.group;
+			st.skew = prev.skew;
+			st.defer = prev.defer;
+			for (std::size_t e = first; e < s; ++e)
+				for (const auto &r : st.reads)
+					if (writes_to(_stages[e], r.grid)) {
+						st.skew = std::max(st.skew, _stages[e].skew + std::max(0, r.offset[0]));
+						st.defer = std::max(st.defer, _stages[e].defer + std::abs(r.offset[0]));
+					}
+		}
+		_planned = true;
+	}
+
+	static dense_space<DIM> slices(dense_space<DIM> box, const int first, const int last) noexcept {
+		box.start[0] = first;
+		box.limit[0] = std::max(first, last);
+		return box;
+	}
+
+	void run_group(const dense_space<DIM> &box, const std::size_t first, const std::size_t last) {
+		const int lo = box.start[0], hi = box.limit[0];
+		const int lag = _stages[last - 1].skew;
+		for (int r = lo; r < hi + lag; ++r)
+			for (std::size_t s = first; s < last; ++s) {
+				const int row = r - _stages[s].skew, d = _stages[s].defer;
+				if (row >= lo + d && row < hi - d) _stages[s].sweep(slices(box, row, row + 1));
+			}
+		// the slices near the slab edges, once the neighbours are done with what they read
+		for (std::size_t s = first; s < last; ++s) {
+			const int d = _stages[s].defer;
+			if (d == 0) continue;
+#pragma omp barrier
+			const int lower = std::min(lo + d, hi);
+			_stages[s].sweep(slices(box, lo, lower));
+			_stages[s].sweep(slices(box, std::max(hi - d, lower), hi));
+		}
+	}
+};
+}
+
+// just a little helper
+template <int DIM> auto fused_loop() { return impl::fused_loop<DIM>(); }
+
+namespace impl {
+// a grid a task graph node touches, in the tile it computes grown by halo
+template <int DIM> struct region_access {
+	const void *grid;
+	std::array<int, DIM> halo;
+	bool write;
+};
+
+// Nodes are kernels over a space, each cut into tiles along dimension 0. A tile depends on the tiles of earlier
+// nodes whose regions of a common grid overlap its own, where at least one of them writes. Every tile is an
+// OpenMP task that is started as soon as its last dependency finished, so independent nodes run side by side and
+// the tiles of a node can start while the node before it is still running elsewhere.
+template <int DIM> struct task_graph {
+	task_graph() = default;
+
+	static region_access<DIM> reads(const void *grid, const std::array<int, DIM> &halo = {}) noexcept {
+		return {grid, halo, false};
+	}
+	static region_access<DIM> writes(const void *grid, const std::array<int, DIM> &halo = {}) noexcept {
+		return {grid, halo, true};
+	}
+
+	// kernel(i, j, ...) over space, tiles are visited in the order make_order(tile) gives, returns the node id
+	template <typename spaceT, typename orderT, typename kernelT>
+	int add(const spaceT &space, orderT &&make_order, kernelT &&kernel, std::vector<region_access<DIM>> accesses,
+			int tiles = 0) {
+		auto k = std::forward<kernelT>(kernel);
+		auto o = std::forward<orderT>(make_order);
+		return add_node(space,
+						[k, o](const dense_space<DIM> &tile) mutable {
+							const auto order = o(tile);
+							for (auto it = order.begin(), end = order.end(); it != end; ++it)
+								apply_index(k, it.index, std::make_index_sequence<DIM>());
+						},
+						std::move(accesses), tiles);
+	}
+
+	// kernel(i, j, ...) over space, row-major within tiles
+	template <typename spaceT, typename kernelT>
+	int add(const spaceT &space, kernelT &&kernel, std::vector<region_access<DIM>> accesses, int tiles = 0) {
+		auto k = std::forward<kernelT>(kernel);
+		return add_node(space,
+						[k](const dense_space<DIM> &tile) mutable {
+							rm_for_each(tile, [&](const std::array<int, DIM> &idx) {
+								apply_index(k, idx, std::make_index_sequence<DIM>());
+							});
+						},
+						std::move(accesses), tiles);
+	}
+
+	std::size_t size() const noexcept { return _nodes; }
+	bool empty() const noexcept { return _nodes == 0; }
+
+	// tiles of node a that tiles of node b wait for
+	std::size_t dependencies(const int a, const int b) const noexcept {
+		std::size_t n = 0;
+		for (const auto &t : _tiles)
+			if (t.node == a)
+				n += std::count_if(t.successors.begin(), t.successors.end(),
+								   [&](const std::size_t s) { return _tiles[s].node == b; });
+		return n;
+	}
+
+	// runs all nodes in a parallel region of its own, can be repeated
+	void run() {
+		std::vector<std::atomic<int>> waiting(_tiles.size());
+		for (std::size_t t = 0; t < _tiles.size(); ++t) waiting[t].store(_tiles[t].predecessors);
+#pragma omp parallel
+#pragma omp single
+		for (std::size_t t = 0; t < _tiles.size(); ++t)
+			if (_tiles[t].predecessors == 0) spawn(t, waiting);
+	}
+
+  private:
+	struct tile {
+		int node;
+		dense_space<DIM> box;
+		std::vector<std::size_t> successors;
+		int predecessors;
+	};
+	struct node {
+		std::function<void(const dense_space<DIM> &)> sweep;
+		std::vector<region_access<DIM>> accesses;
+	};
+	std::vector<node> _kernels;
+	std::vector<tile> _tiles;
+	int _nodes = 0;
+
+	bool conflict(const tile &a, const tile &b) const noexcept {
+		for (const auto &x : _kernels[a.node].accesses)
+			for (const auto &y : _kernels[b.node].accesses)
+				if (x.grid == y.grid && (x.write || y.write) &&
+					!intersect(grow(a.box, x.halo), grow(b.box, y.halo)).empty())
+					return true;
+		return false;
+	}
+
+	template <typename spaceT>
+	int add_node(const spaceT &space, std::function<void(const dense_space<DIM> &)> sweep,
+				 std::vector<region_access<DIM>> accesses, int tiles) {
+		const dense_space<DIM> box(space.start, space.limit);
+		_kernels.push_back({std::move(sweep), std::move(accesses)});
+		const int id = _nodes++;
+		const std::size_t first = _tiles.size();
+		if (tiles <= 0) tiles = omp_get_max_threads();
+		tiles = std::max(1, std::min(tiles, box.limit[0] - box.start[0]));
+		for (int t = 0; t < tiles && !box.empty(); ++t) {
+			dense_space<DIM> b(box);
+			std::tie(b.start[0], b.limit[0]) = split(box.start[0], box.limit[0], tiles, t);
+			_tiles.push_back({id, b, {}, 0});
+			auto &mine = _tiles.back();
+			for (std::size_t e = 0; e < first; ++e)
+				if (conflict(_tiles[e], mine)) {
+					_tiles[e].successors.push_back(_tiles.size() - 1);
+					++mine.predecessors;
+				}
+		}
+		return id;
+	}
+
+	void spawn(const std::size_t t, std::vector<std::atomic<int>> &waiting) {
+#pragma omp task default(shared) firstprivate(t)
+		{
+			_kernels[_tiles[t].node].sweep(_tiles[t].box);
+			for (const std::size_t s : _tiles[t].successors)
+				if (waiting[s].fetch_sub(1, std::memory_order_acq_rel) == 1) spawn(s, waiting);
+		}
+	}
+};
+}
+
+// just a little helper
+template <int DIM> auto task_graph() { return impl::task_graph<DIM>(); }
+
+namespace impl {
+// the two halves of the longest dimension of part, the first longest one on ties
+template <typename spaceT> std::pair<spaceT, spaceT> halve_longest(const spaceT &part) {
+	int d = 0;
+	for (int k = 1; k < spaceT::dim; ++k)
+		if (part.limit[k] - part.start[k] > part.limit[d] - part.start[d]) d = k;
+	std::pair<spaceT, spaceT> halves(part, part);
+	halves.first.limit[d] = halves.second.start[d] = part.start[d] + (part.limit[d] - part.start[d]) / 2;
+	return halves;
+}
+
+// Turns a space into OpenMP tasks instead of one slab per thread: with dim >= 0 a taskloop over chunks of grain
+// rows of dimension dim, with dim < 0 recursive halving of the longest dimension down to at most grain points.
+// Tasks join the team of the caller, so kernels can run from inside task-parallel code without a nested parallel
+// region; only a caller outside any parallel region gets a region of its own.
+template <typename spaceT> struct task_partition {
+	spaceT space;
+	int dim;
+	std::ptrdiff_t grain;
+
+	task_partition() = delete;
+	task_partition(const int d, const spaceT &s, const std::ptrdiff_t g)
+		: space(s), dim(d), grain(std::max<std::ptrdiff_t>(g, 1)) {}
+
+	// kernel(i, j, ...) over every point, each task visiting its part in the order make_order(part) gives. Call
+	// from one thread, e.g. in a single construct or a task, it returns once all tasks finished.
+	template <typename orderT, typename kernelT> void for_each(orderT &&make_order, kernelT &&kernel) const {
+		if (space.empty()) return;
+		if (omp_in_parallel()) {
+#pragma omp taskgroup
+			spawn(make_order, kernel);
+		} else {
+#pragma omp parallel
+#pragma omp single
+			spawn(make_order, kernel);
+		}
+	}
+
+	// row-major within each task
+	template <typename kernelT> void for_each(kernelT &&kernel) const {
+		for_each([](const spaceT &s) { return rm_order<spaceT>(s); }, std::forward<kernelT>(kernel));
+	}
+
+  private:
+	template <typename orderT, typename kernelT> void spawn(orderT &make_order, kernelT &kernel) const {
+		if (dim < 0) {
+			bisect(space, make_order, kernel);
+			return;
+		}
+		const int first = space.start[dim], rows = space.limit[dim] - first;
+		const int chunks = int((rows + grain - 1) / grain);
+#pragma omp taskloop default(shared) grainsize(1)
+		for (int c = 0; c < chunks; ++c) {
+			spaceT part(space);
+			part.start[dim] = first + int(c * grain);
+			part.limit[dim] = int(std::min<std::ptrdiff_t>(part.start[dim] + grain, space.limit[dim]));
+			leaf(part, make_order, kernel);
+		}
+	}
+
+	template <typename orderT, typename kernelT>
+	void bisect(const spaceT &part, orderT &make_order, kernelT &kernel) const {
+		if (std::ptrdiff_t(part.size()) <= grain) {
+			leaf(part, make_order, kernel);
+			return;
+		}
+		const auto halves = halve_longest(part);
+		const spaceT lower = halves.first;
+#pragma omp task default(shared) firstprivate(lower)
+		bisect(lower, make_order, kernel);
+		bisect(halves.second, make_order, kernel);
+	}
+
+	template <typename orderT, typename kernelT>
+	static void leaf(const spaceT &part, orderT &make_order, kernelT &kernel) {
+		const auto order = make_order(part);
+		for (auto it = order.begin(), end = order.end(); it != end; ++it)
+			apply_index(kernel, it.index, std::make_index_sequence<spaceT::dim>());
+	}
+};
+}
+
+// just a little helper, a taskloop over chunks of grain rows of dimension dim
+template <typename T> auto task_partition(const int dim, T &&space, const std::ptrdiff_t grain) {
+	return impl::task_partition<std::decay_t<T>>(dim, std::forward<T>(space), grain);
+}
+
+// just a little helper, recursive bisection into tasks of at most grain points
+template <typename T> auto bisect_partition(T &&space, const std::ptrdiff_t grain) {
+	return impl::task_partition<std::decay_t<T>>(-1, std::forward<T>(space), grain);
+}
+
+namespace impl {
+template <typename spaceT, template <typename> class innerT> struct bisect_order;
+
+template <typename spaceT, template <typename> class innerT> struct bisect_iteration {
+	using inner_type = decltype(std::declval<const innerT<spaceT> &>().begin());
+
+	std::array<int, spaceT::dim> index;
+	std::size_t leaf;
+
+	bool operator!=(const bisect_iteration<spaceT, innerT> &rhs) const noexcept {
+		return leaf != rhs.leaf || _it != rhs._it;
+	}
+
+	void operator++() noexcept {
+		++_it;
+		settle();
+	}
+
+	auto operator*() const noexcept { return impl::array_to_tuple<spaceT::dim, decltype(index)>::get(index); }
+
+  private:
+	friend struct bisect_order<spaceT, innerT>;
+	const std::vector<spaceT> *_leaves;
+	inner_type _it, _end;
+
+	void open() noexcept {
+		const innerT<spaceT> order((*_leaves)[leaf]);
+		_it = order.begin();
+		_end = order.end();
+	}
+
+	// moves on to the next leaf with points left, past the end compares equal to end()
+	void settle() noexcept {
+		while (!(_it != _end)) {
+			if (++leaf >= _leaves->size()) {
+				leaf = _leaves->size();
+				_it = _end = inner_type();
+				return;
+			}
+			open();
+		}
+		index = _it.index;
+	}
+};
+
+// Cache-oblivious order: the longest dimension is halved recursively until the blocks have at most grain points,
+// the blocks are visited in the order of the recursion, each with the inner order. Close points stay close in time
+// at every block size, so every cache level sees locality without a tuned tile size.
+template <typename spaceT, template <typename> class innerT = rm_order> struct bisect_order {
+	static constexpr int dim = spaceT::dim;
+
+	spaceT _space;
+	std::ptrdiff_t grain;
+	std::vector<spaceT> leaves; // in visiting order
+
+	bisect_order() = delete;
+	bisect_order(const spaceT &s, const std::ptrdiff_t g) : _space(s), grain(std::max<std::ptrdiff_t>(g, 1)) {
+		if (!_space.empty()) bisect(_space);
+	}
+
+	std::ptrdiff_t size() const noexcept {
+		std::ptrdiff_t n = 0;
+		for (const auto &l : leaves) n += l.size();
+		return n;
+	}
+
+	bisect_iteration<spaceT, innerT> begin() const noexcept {
+		bisect_iteration<spaceT, innerT> it;
+		it._leaves = &leaves;
+		it.leaf = 0;
+		if (leaves.empty()) {
+			it._it = it._end = typename bisect_iteration<spaceT, innerT>::inner_type();
+			return it;
+		}
+		it.open();
+		it.settle();
+		return it;
+	}
+
+	bisect_iteration<spaceT, innerT> end() const noexcept {
+		bisect_iteration<spaceT, innerT> it;
+		it._leaves = &leaves;
+		it.leaf = leaves.size();
+		it._it = it._end = typename bisect_iteration<spaceT, innerT>::inner_type();
+		return it;
+	}
+
+	// the same blocks as the order, the halves forked as OpenMP tasks, see task_partition
+	template <typename kernelT> void parallel_for_each(kernelT &&kernel) const {
+		task_partition<spaceT>(-1, _space, grain)
+			.for_each([](const spaceT &s) { return innerT<spaceT>(s); }, std::forward<kernelT>(kernel));
+	}
+
+  private:
+	void bisect(const spaceT &part) {
+		if (std::ptrdiff_t(part.size()) <= grain) {
+			leaves.push_back(part);
+			return;
+		}
+		const auto halves = halve_longest(part);
+		bisect(halves.first);
+		bisect(halves.second);
+	}
+};
+}
+
+// just a little helper, e.g. bisect_order(space, 256) or bisect_order<impl::cm_order>(space, 256)
+template <template <typename> class innerT = impl::rm_order, typename T>
+auto bisect_order(T &&space, const std::ptrdiff_t grain) {
+	return impl::bisect_order<std::decay_t<T>, innerT>(std::forward<T>(space), grain);
+}
+
+// how thread_plan::pin places threads: compact fills cores and nodes one after the other, scatter spreads the threads
+// over nodes and cores before using second hardware threads, numa_balanced gives every node an equal share of
+// consecutive threads, explicit_list takes the cpus given
+enum class affinity { compact, scatter, numa_balanced, explicit_list };
+
+namespace impl {
+// cpu numbers in the sysfs list format, e.g. "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+	std::vector<int> cpus;
+	std::size_t pos = 0;
+	while (pos < list.size()) {
+		std::size_t end = list.find(',', pos);
+		if (end == std::string::npos) end = list.size();
+		const std::string item = list.substr(pos, end - pos);
+		const std::size_t dash = item.find('-');
+		if (!item.empty()) {
+			const int first = std::stoi(item);
+			const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+			for (int c = first; c <= last; ++c) cpus.push_back(c);
+		}
+		pos = end + 1;
+	}
+	return cpus;
+}
+
+// the hardware threads sharing a core with cpu, just cpu if sysfs does not tell
+inline std::vector<int> cpu_siblings(const int cpu) {
+	std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+	std::string list;
+	std::vector<int> siblings;
+	if (file >> list) siblings = parse_cpu_list(list);
+	if (siblings.empty()) siblings.push_back(cpu);
+	return siblings;
+}
+
+// the cpus the process may run on, as of the first call
+inline const std::vector<int> &allowed_cpus() {
+	static const std::vector<int> cpus = [] {
+		std::vector<int> result;
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+			for (int c = 0; c < CPU_SETSIZE; ++c)
+				if (CPU_ISSET(c, &set)) result.push_back(c);
+#endif
+		if (result.empty())
+			for (int c = 0; c < std::max(1, int(std::thread::hardware_concurrency())); ++c) result.push_back(c);
+		return result;
+	}();
+	return cpus;
+}
+
+// the allowed cpus by NUMA node, each node's cores with their hardware threads, one node if sysfs does not tell
+inline std::vector<std::vector<std::vector<int>>> cpu_topology() {
+	const auto &allowed = allowed_cpus();
+	std::vector<std::vector<int>> nodes;
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string list;
+	if (online >> list)
+		for (const int n : parse_cpu_list(list)) {
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+			std::string cpus;
+			std::vector<int> mine;
+			if (file >> cpus)
+				for (const int c : parse_cpu_list(cpus))
+					if (std::binary_search(allowed.begin(), allowed.end(), c)) mine.push_back(c);
+			if (!mine.empty()) nodes.push_back(mine);
+		}
+	if (nodes.empty()) nodes.push_back(allowed);
+
+	std::vector<std::vector<std::vector<int>>> topology;
+	for (const auto &node : nodes) {
+		std::vector<std::pair<int, int>> keyed; // first hardware thread of the core, cpu
+		for (const int c : node) keyed.emplace_back(cpu_siblings(c).front(), c);
+		std::sort(keyed.begin(), keyed.end());
+		std::vector<std::vector<int>> cores;
+		for (std::size_t k = 0; k < keyed.size(); ++k) {
+			if (k == 0 || keyed[k].first != keyed[k - 1].first) cores.emplace_back();
+			cores.back().push_back(keyed[k].second);
+		}
+		topology.push_back(cores);
+	}
+	return topology;
+}
+
+// the cpu of each of threads under policy
+inline std::vector<int> place_threads(const affinity policy, const int threads, const std::vector<int> &cpus) {
+	std::vector<int> result(threads, -1);
+	if (policy == affinity::explicit_list) {
+		assert(!cpus.empty() && "affinity::explicit_list needs cpus");
+		for (int t = 0; t < threads && !cpus.empty(); ++t) result[t] = cpus[t % cpus.size()];
+		return result;
+	}
+	const auto topology = cpu_topology();
+	auto compact = [](const std::vector<std::vector<int>> &cores) {
+		std::vector<int> r;
+		for (const auto &core : cores) r.insert(r.end(), core.begin(), core.end());
+		return r;
+	};
+	std::vector<int> order;
+	if (policy == affinity::scatter) {
+		std::size_t cores = 0, siblings = 0;
+		for (const auto &node : topology) {
+			cores = std::max(cores, node.size());
+			for (const auto &core : node) siblings = std::max(siblings, core.size());
+		}
+		for (std::size_t r = 0; r < siblings; ++r)
+			for (std::size_t k = 0; k < cores; ++k)
+				for (const auto &node : topology)
+					if (k < node.size() && r < node[k].size()) order.push_back(node[k][r]);
+	} else if (policy == affinity::numa_balanced) {
+		const int nodes = int(topology.size());
+		for (int n = 0; n < nodes; ++n) {
+			const auto mine = compact(topology[n]);
+			const auto range = split(0, threads, nodes, n);
+			for (int t = range.first; t < range.second; ++t) result[t] = mine[(t - range.first) % mine.size()];
+		}
+		return result;
+	} else {
+		for (const auto &node : topology) {
+			const auto mine = compact(node);
+			order.insert(order.end(), mine.begin(), mine.end());
+		}
+	}
+	for (int t = 0; t < threads; ++t) result[t] = order[t % order.size()];
+	return result;
+}
+
+// pins the calling thread to cpu
+inline bool pin_to(const int cpu) noexcept {
+#if defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+inline int current_cpu() noexcept {
+#if defined(__linux__)
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+
+// Where the threads of a parallel region run: the cpu of every OpenMP thread, and the threads grouped by the core
+// they share. Cores and slabs are numbered in the order of the cpus, so neighbouring slabs land on neighbouring
+// cores whichever thread ids the runtime hands out.
+struct thread_plan {
+	std::vector<int> cpu;	  // per thread, -1 if unknown
+	std::vector<int> core;	  // per thread, its core among the cores in use
+	std::vector<int> rank;	  // per thread, its position among the threads of its core
+	std::vector<int> sharing; // per thread, the number of threads on its core
+	std::vector<int> slab;	  // per thread, its slab when slabs follow the cpus rather than the thread ids
+	int cores = 0;
+
+	thread_plan() = default;
+
+	// Records where the threads run right now, by all threads of the parallel region. Threads that are not pinned
+	// may migrate afterwards, the plan then only describes where they started.
+	void detect() {
+#pragma omp single
+		cpu.assign(omp_get_num_threads(), -1);
+		cpu[omp_get_thread_num()] = current_cpu();
+#pragma omp barrier
+#pragma omp single
+		group();
+	}
+
+	// fills in the rest from cpu
+	void group() {
+		const int threads = int(cpu.size());
+		core.assign(threads, 0);
+		rank.assign(threads, 0);
+		sharing.assign(threads, 1);
+		std::vector<int> key(threads); // the first hardware thread of the core, unknown cpus first by thread id
+		for (int t = 0; t < threads; ++t) key[t] = cpu[t] < 0 ? INT_MIN + t : cpu_siblings(cpu[t]).front();
+		std::vector<int> keys(key);
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		cores = int(keys.size());
+		std::vector<int> count(cores, 0);
+		for (int t = 0; t < threads; ++t) {
+			core[t] = int(std::lower_bound(keys.begin(), keys.end(), key[t]) - keys.begin());
+			rank[t] = count[core[t]]++;
+		}
+		for (int t = 0; t < threads; ++t) sharing[t] = count[core[t]];
+
+		std::vector<int> order(threads);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return cpu[a] < cpu[b]; });
+		slab.assign(threads, 0);
+		for (int k = 0; k < threads; ++k) slab[order[k]] = k;
+	}
+
+	// Pins every thread to a cpu chosen by policy and records it, by all threads of the parallel region. With
+	// affinity::explicit_list thread t gets cpus[t % cpus.size()], an empty list pins nothing. Returns false on
+	// all threads unless every thread was pinned, the plan then still describes the intended placement.
+	bool pin(const affinity policy, const std::vector<int> &cpus = {}) {
+#pragma omp single
+		{
+			cpu = place_threads(policy, omp_get_num_threads(), cpus);
+			group();
+			_unpinned = 0;
+		}
+		if (!pin_to(cpu[omp_get_thread_num()])) {
+#pragma omp atomic
+			++_unpinned;
+		}
+#pragma omp barrier
+		const bool pinned = _unpinned == 0;
+#pragma omp barrier // everyone has read it before the next pin() resets it
+		return pinned;
+	}
+
+  private:
+	int _unpinned = 0; // threads pin() could not pin
+};
+
+// The calling thread's part of the space with SMT in mind: one slab of dimension dim per core, and the hardware
+// threads of a core share that slab, each taking adjacent parts of dimension inner. Siblings sweep the same rows at
+// the same time, so the core's L1 and L2 hold one working set instead of two.
+template <typename spaceT> struct smt_partition : public spaceT {
+	smt_partition() = delete;
+	smt_partition(const smt_partition<spaceT> &) = default;
+	smt_partition(smt_partition<spaceT> &&) = default;
+	smt_partition<spaceT> &operator=(const smt_partition<spaceT> &) = default;
+	smt_partition<spaceT> &operator=(smt_partition<spaceT> &&) = default;
+
+	smt_partition(const int dim, const int inner, const spaceT &o, const thread_plan &plan) : spaceT(o) {
+		partition(dim, inner, plan);
+	}
+
+  private:
+	void partition(const int dim, const int inner, const thread_plan &plan) noexcept {
+		const int id = omp_get_thread_num();
+		assert(int(plan.core.size()) == omp_get_num_threads());
+		std::tie(spaceT::start[dim], spaceT::limit[dim]) =
+			split(spaceT::start[dim], spaceT::limit[dim], plan.cores, plan.core[id]);
+		std::tie(spaceT::start[inner], spaceT::limit[inner]) =
+			split(spaceT::start[inner], spaceT::limit[inner], plan.sharing[id], plan.rank[id]);
+	}
+};
+}
+
+// just a little helper, declare one per parallel region and fill it with detect() or pin()
+using thread_plan = impl::thread_plan;
+
+// the cpu the calling thread runs on right now, -1 if unknown
+inline int current_cpu() noexcept { return impl::current_cpu(); }
+
+// just a little helper, siblings split the innermost dimension
+template <typename T> auto smt_partition(const int dim, T &&instance, const thread_plan &plan) {
+	return impl::smt_partition<std::decay_t<T>>(dim, std::decay_t<T>::dim - 1, std::forward<T>(instance), plan);
+}
+
+template <typename T> auto smt_partition(const int dim, const int inner, T &&instance, const thread_plan &plan) {
+	return impl::smt_partition<std::decay_t<T>>(dim, inner, std::forward<T>(instance), plan);
+}
+
+// just a little helper, the slab follows the cpu of the calling thread in plan instead of its thread id
+template <typename T> auto static_partition(const int dim, T &&instance, const thread_plan &plan) {
+	return impl::static_partition<std::decay_t<T>>(dim, std::forward<T>(instance), int(plan.slab.size()),
+													plan.slab[omp_get_thread_num()]);
+}
+
+#if defined(__linux__)
+namespace impl {
+inline void futex_wait(std::atomic<int> *word, const int expected) noexcept {
+	syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<int> *word) noexcept {
+	syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// A global dense_space split along dimension 0 across ranks, i.e. processes on one node. All subdomains live in
+// one POSIX shared memory segment, so a rank reads the halo of its neighbours directly from their subdomains,
+// without copies. Inside of a rank the OpenMP partitions apply to subdomain(rank) as usual.
+template <int DIM, typename T = double> struct shm_decomposition {
+	dense_space<DIM> global;
+	int ranks;
+	int fields; // arrays per subdomain, e.g. 2 to double buffer
+
+	shm_decomposition() = delete;
+	shm_decomposition(const shm_decomposition<DIM, T> &) = delete;
+	shm_decomposition(shm_decomposition<DIM, T> &&o) noexcept
+		: global(o.global), ranks(o.ranks), fields(o.fields), _name(std::move(o._name)), _creator(o._creator),
+		  _header(o._header), _bytes(o._bytes), _base(o._base), _slots(o._slots) {
+		o._base = nullptr;
+		o._creator = -1;
+	}
+
+	// create is true for the one process setting up the segment, everyone else attaches to it by name.
+	// Processes forked after creating share the mapping and need not attach. Throws std::system_error if the
+	// segment cannot be created (e.g. a stale one of the same name exists), opened or mapped.
+	shm_decomposition(const std::string &name, const dense_space<DIM> &g, const int r, const int f, const bool create)
+		: global(g), ranks(r), fields(f), _name(name), _creator(-1), _base(nullptr) {
+		_header = (sizeof(slot) * ranks + 4095) / 4096 * 4096;
+		_bytes = _header;
+		for (int k = 0; k < ranks; ++k) _bytes += bytes(k);
+
+		const int fd = shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+		if (fd < 0) throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+		if (create) _creator = getpid(); // from here on the segment is ours to unlink, also on failure
+		auto fail = [&](const char *what) {
+			const int error = errno;
+			close(fd);
+			if (create) shm_unlink(name.c_str());
+			throw std::system_error(error, std::generic_category(), what + (" " + name));
+		};
+		if (create && ftruncate(fd, off_t(_bytes)) != 0) fail("ftruncate");
+		void *base = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (base == MAP_FAILED) fail("mmap");
+		close(fd);
+		_base = static_cast<char *>(base);
+		_slots = reinterpret_cast<slot *>(_base);
+		if (create)
+			for (int k = 0; k < ranks; ++k) new (&_slots[k]) slot();
+	}
+
+	~shm_decomposition() {
+		if (_base) munmap(_base, _bytes);
+		if (_creator == getpid()) shm_unlink(_name.c_str());
+	}
+
+	dense_space<DIM> subdomain(const int rank) const noexcept {
+		dense_space<DIM> s(global);
+		std::tie(s.start[0], s.limit[0]) = split(global.start[0], global.limit[0], ranks, rank);
+		return s;
+	}
+
+	int rank_of(const int row) const noexcept {
+		int lo = 0, hi = ranks - 1;
+		while (lo < hi) {
+			const int mid = (lo + hi + 1) / 2;
+			if (subdomain(mid).start[0] <= row)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		return lo;
+	}
+
+	// any point of the global space, whichever rank owns it
+	T &at(const int field, const std::array<int, DIM> &idx) const noexcept {
+		const int rank = rank_of(idx[0]);
+		return data(field, rank)[subdomain(rank).linear_offset(idx)];
+	}
+
+	// the row-major array of a field of a subdomain
+	T *data(const int field, const int rank) const noexcept {
+		std::size_t offset = _header;
+		for (int k = 0; k < rank; ++k) offset += bytes(k);
+		return reinterpret_cast<T *>(_base + offset) + std::size_t(field) * subdomain(rank).size();
+	}
+
+	// Tells the neighbours that rank finished writing its subdomain for this step, then sleeps until they finished
+	// the same step. Neighbouring ranks are never more than one step apart, so reading the halo from one field
+	// while writing the other is safe.
+	void exchange(const int rank) noexcept {
+		const int step = _slots[rank].step.fetch_add(1) + 1;
+		futex_wake(&_slots[rank].step);
+		for (const int n : {rank - 1, rank + 1}) {
+			if (n < 0 || n >= ranks) continue;
+			for (int seen; (seen = _slots[n].step.load()) < step;) futex_wait(&_slots[n].step, seen);
+		}
+	}
+
+  private:
+	struct alignas(64) slot {
+		std::atomic<int> step{0};
+	};
+
+	std::string _name;
+	int _creator;
+	std::size_t _header, _bytes;
+	char *_base;
+	slot *_slots;
+
+	std::size_t bytes(const int rank) const noexcept {
+		return (std::size_t(fields) * subdomain(rank).size() * sizeof(T) + 63) / 64 * 64;
+	}
+};
+}
+
+// just a little helper
+template <typename T = double, int DIM>
+auto shm_decomposition(const std::string &name, const impl::dense_space<DIM> &global, const int ranks,
+					   const int fields, const bool create) {
+	return impl::shm_decomposition<DIM, T>(name, global, ranks, fields, create);
+}
+
+// Jacobi sweeps by ranks forked processes, each with its own OpenMP team, on one shm_decomposition, compared with
+// the same sweeps in a single process. Call before this process ran a parallel region, forking a live OpenMP
+// runtime is not safe.
+inline bool shm_check(const int ranks = 4, const int steps = 50) {
+	const auto global = dense_space(0, 64, 0, 48), interior = dense_space(1, 63, 1, 47);
+	auto initial = [&](const std::array<int, 2> &idx) { return interior.contains(idx) ? 0.0 : 1.0; };
+	auto shm = shm_decomposition("/space_shm_check_" + std::to_string(getpid()), global, ranks, 2, true);
+	impl::rm_for_each(global, [&](const std::array<int, 2> &idx) { shm.at(0, idx) = shm.at(1, idx) = initial(idx); });
+
+	auto sweep = [&](const int rank) {
+		const auto mine = impl::intersect(shm.subdomain(rank), interior);
+		for (int k = 0; k < steps; ++k) {
+			const int src = k % 2, dst = 1 - src;
+#pragma omp parallel
+			for (const auto &iteration : rm_order(static_partition(0, mine))) {
+				int i, j;
+				std::tie(i, j) = iteration;
+				shm.at(dst, {{i, j}}) = (shm.at(src, {{i - 1, j}}) + shm.at(src, {{i + 1, j}}) +
+										 shm.at(src, {{i, j - 1}}) + shm.at(src, {{i, j + 1}})) / 4;
+			}
+			shm.exchange(rank);
+		}
+	};
+	std::vector<pid_t> children;
+	for (int r = 1; r < ranks; ++r) {
+		const pid_t pid = fork();
+		if (pid == 0) {
+			sweep(r);
+			_exit(0);
+		}
+		children.push_back(pid);
+	}
+	sweep(0);
+	bool ok = true;
+	for (const pid_t pid : children) {
+		int status = 0;
+		ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+	}
+
+	std::vector<double> fields[2];
+	for (auto &f : fields) {
+		f.resize(global.size());
+		impl::rm_for_each(global, [&](const std::array<int, 2> &idx) { f[global.linear_offset(idx)] = initial(idx); });
+	}
+	for (int k = 0; k < steps; ++k) {
+		const auto &src = fields[k % 2];
+		auto &dst = fields[1 - k % 2];
+		impl::rm_for_each(interior, [&](const std::array<int, 2> &idx) {
+			const int i = idx[0], j = idx[1];
+			dst[global.linear_offset(idx)] =
+				(src[global.linear_offset({{i - 1, j}})] + src[global.linear_offset({{i + 1, j}})] +
+				 src[global.linear_offset({{i, j - 1}})] + src[global.linear_offset({{i, j + 1}})]) / 4;
+		});
+	}
+	impl::rm_for_each(global, [&](const std::array<int, 2> &idx) {
+		ok = ok && shm.at(steps % 2, idx) == fields[steps % 2][global.linear_offset(idx)];
+	});
+	std::cout << "shm: " << ranks << " ranks x " << omp_get_max_threads() << " threads "
+			  << (ok ? "match" : "differ from") << " a single process" << std::endl;
+	return ok;
+}
+#endif
+
+int main(int argc, char const *argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "bench") {
+		bench_orders();
+		return 0;
+	}
+#if defined(__linux__)
+	if (argc > 1 && std::string(argv[1]) == "shm") return shm_check(argc > 2 ? std::stoi(argv[2]) : 4) ? 0 : 1;
+#endif
 
 	double arr1[100][100], arr2[100][100];
 